@@ -0,0 +1,308 @@
+﻿#include <openps.h>
+#include <chrono>
+#include <random>
+
+namespace
+{
+    ref<openps::physics> physics;
+
+    std::vector<openps::rigidbody*> bodies;
+    std::vector<openps::collider_base*> colliders;
+
+    constexpr uint32_t nbProps = 100000U;
+    constexpr uint32_t nbWarmupSteps = 10U;
+    constexpr uint32_t nbMeasuredSteps = 100U;
+    constexpr float stepDt = 1.0f / 60.0f;
+
+    constexpr uint32_t nbRays = 100000U;
+    constexpr uint32_t nbRayRounds = 10U;
+
+    constexpr uint64_t frameBytes = MB(256);
+    constexpr uint64_t frameAllocationSize = KB(4);
+    constexpr uint32_t nbFrames = 20U;
+}
+
+static void test_log_message(const char* message) { std::cout << message << "\n"; }
+static void test_log_error(const char* message) { std::cerr << message << "\n"; }
+
+static void report(const char* name, double totalMs, uint32_t count, const char* unit)
+{
+    std::cout << name << ": " << totalMs << " ms total, " << (totalMs * 1000.0 / count) << " us per " << unit << "\n";
+}
+
+static void initialize()
+{
+    openps::physics_desc desc{};
+    desc.logErrorFunc = test_log_error;
+    desc.logMessageFunc = test_log_message;
+
+    physics = make_ref<openps::physics>(desc);
+}
+
+static void release()
+{
+    physics.reset();
+
+    for (openps::rigidbody* rb : bodies)
+        delete rb;
+
+    for (openps::collider_base* collider : colliders)
+        delete collider;
+
+    bodies.clear();
+    colliders.clear();
+}
+
+// Small dynamic boxes on a grid above a static ground, a typical prop-heavy level
+static void createProps(std::vector<physx::PxRigidActor*>& actors)
+{
+    const uint32_t side = (uint32_t)std::ceil(std::sqrt((float)nbProps));
+    const float spacing = 2.0f;
+
+    openps::rigidbody* ground = bodies.emplace_back(new openps::rigidbody(0, openps::rigidbody_type::Static));
+    openps::collider_base* groundCollider = colliders.emplace_back(new openps::box_collider(side * spacing, 1.0f, side * spacing));
+    openps::createRigidbodyActor(ground, groundCollider, physx::PxTransform(physx::PxVec3(0, -1.0f, 0)));
+
+    openps::collider_base* propCollider = colliders.emplace_back(new openps::box_collider(0.5f, 0.5f, 0.5f));
+
+    actors.reserve(nbProps);
+
+    for (uint32_t i = 0; i < nbProps; ++i)
+    {
+        const float x = ((i % side) - side * 0.5f) * spacing;
+        const float z = ((i / side) - side * 0.5f) * spacing;
+
+        openps::rigidbody* rb = bodies.emplace_back(new openps::rigidbody(i + 1, openps::rigidbody_type::Dynamic));
+        actors.push_back(openps::createRigidbodyActor(rb, propCollider, physx::PxTransform(physx::PxVec3(x, 0.5f, z))));
+    }
+}
+
+static double measureSteps()
+{
+    for (uint32_t i = 0; i < nbWarmupSteps; ++i)
+        physics->update(stepDt);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (uint32_t i = 0; i < nbMeasuredSteps; ++i)
+        physics->update(stepDt);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Same props stepped once as loose actors, once clustered by aggregate_builder
+static void benchmarkAggregates()
+{
+    {
+        initialize();
+
+        std::vector<physx::PxRigidActor*> actors;
+        createProps(actors);
+
+        report("Broadphase, 100k loose props", measureSteps(), nbMeasuredSteps, "step");
+
+        release();
+    }
+
+    {
+        initialize();
+
+        std::vector<physx::PxRigidActor*> actors;
+        createProps(actors);
+
+        openps::aggregate_builder builder;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (physx::PxRigidActor* actor : actors)
+            builder.addActor(actor);
+        builder.build();
+
+        auto end = std::chrono::high_resolution_clock::now();
+        report("Aggregate build, 100k props", std::chrono::duration<double, std::milli>(end - start).count(), nbProps, "actor");
+
+        std::cout << "Aggregates: " << builder.getNbAggregates() << "\n";
+
+        report("Broadphase, 100k aggregated props", measureSteps(), nbMeasuredSteps, "step");
+
+        builder.release();
+        release();
+    }
+}
+
+static void createRays(std::vector<openps::raycast_ray>& rays)
+{
+    const uint32_t side = (uint32_t)std::ceil(std::sqrt((float)nbProps));
+    const float extent = side * 2.0f;
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coord(-extent * 0.5f, extent * 0.5f);
+
+    rays.resize(nbRays);
+
+    for (openps::raycast_ray& ray : rays)
+    {
+        ray.origin = physx::PxVec3(coord(random), 10.0f, coord(random));
+        ray.maxDistance = 20.0f;
+    }
+}
+
+// Downward rays over the props, one by one on this thread and as raycastBatch on the query dispatcher
+static void benchmarkRaycasts()
+{
+    initialize();
+
+    std::vector<physx::PxRigidActor*> actors;
+    createProps(actors);
+
+    for (uint32_t i = 0; i < nbWarmupSteps; ++i)
+        physics->update(stepDt);
+
+    std::vector<openps::raycast_ray> rays;
+    createRays(rays);
+
+    std::vector<openps::raycast_hit> hits(nbRays);
+
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (uint32_t round = 0; round < nbRayRounds; ++round)
+            for (uint32_t i = 0; i < nbRays; ++i)
+                physics->raycast(rays[i].origin, rays[i].direction, hits[i], rays[i].maxDistance);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        report("Raycast, single", std::chrono::duration<double, std::milli>(end - start).count(), nbRays * nbRayRounds, "ray");
+    }
+
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (uint32_t round = 0; round < nbRayRounds; ++round)
+            physics->raycastBatch(rays, hits);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        report("Raycast, batch", std::chrono::duration<double, std::milli>(end - start).count(), nbRays * nbRayRounds, "ray");
+    }
+
+    release();
+}
+
+// Raycast batches issued between beginStep and endStep, against batches issued after update()
+static void benchmarkQueriesDuringStep()
+{
+    initialize();
+
+    std::vector<physx::PxRigidActor*> actors;
+    createProps(actors);
+
+    for (uint32_t i = 0; i < nbWarmupSteps; ++i)
+        physics->update(stepDt);
+
+    std::vector<openps::raycast_ray> rays;
+    createRays(rays);
+
+    std::vector<openps::raycast_hit> hits(nbRays);
+
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (uint32_t i = 0; i < nbMeasuredSteps; ++i)
+        {
+            physics->update(stepDt);
+            physics->raycastBatch(rays, hits);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        report("Step then query", std::chrono::duration<double, std::milli>(end - start).count(), nbMeasuredSteps, "step");
+    }
+
+    {
+        uint64_t nbBatches = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (uint32_t i = 0; i < nbMeasuredSteps; ++i)
+        {
+            physics->beginStep();
+
+            do
+            {
+                physics->raycastBatch(rays, hits);
+                ++nbBatches;
+            }
+            while (!physics->endStep(false));
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        report("Query during step", std::chrono::duration<double, std::milli>(end - start).count(), nbMeasuredSteps, "step");
+
+        std::cout << "Ray batches per step: " << (double)nbBatches / nbMeasuredSteps << "\n";
+    }
+
+    release();
+}
+
+// Fills the frame with page sized allocations and touches every byte, so commit and page fault costs show up
+static double runAllocatorFrame(openps::eallocator& allocator)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (uint64_t size = 0; size < frameBytes; size += frameAllocationSize)
+        memset(allocator.allocate(frameAllocationSize, 16), 1, frameAllocationSize);
+
+    allocator.reset();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void benchmarkAllocatorPages(const char* name, openps::page_mode pages)
+{
+    openps::eallocator allocator;
+    allocator.initialize(0, GB(1), pages);
+
+    std::cout << name << "\n";
+
+    report("  First frame", runAllocatorFrame(allocator), 1U, "frame");
+
+    double total = 0.0;
+    for (uint32_t i = 0; i < nbFrames; ++i)
+        total += runAllocatorFrame(allocator);
+
+    report("  Warm frames", total, nbFrames, "frame");
+
+    auto start = std::chrono::high_resolution_clock::now();
+    allocator.decommit();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    report("  Decommit", std::chrono::duration<double, std::milli>(end - start).count(), 1U, "call");
+
+    report("  Frame after decommit", runAllocatorFrame(allocator), 1U, "frame");
+}
+
+// Frame arena sized work with each page mode, huge pages only differ on Linux
+static void benchmarkAllocator()
+{
+    benchmarkAllocatorPages("Allocator, default pages", openps::page_mode::Default);
+    benchmarkAllocatorPages("Allocator, transparent huge pages", openps::page_mode::TransparentHuge);
+    benchmarkAllocatorPages("Allocator, explicit huge pages", openps::page_mode::ExplicitHuge);
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        benchmarkAggregates();
+        benchmarkRaycasts();
+        benchmarkQueriesDuringStep();
+        benchmarkAllocator();
+    }
+    catch (...)
+    {
+        openps::logger::log_error("Runtime Error!");
+        return -1;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -9,22 +9,92 @@ namespace openps
 	{
 		px_aggregate() = default;
 
-		px_aggregate(uint8_t nb, bool sc = true) noexcept;
+		px_aggregate(uint32_t nb, bool sc = true, physx::PxAggregateType::Enum aggregateType = physx::PxAggregateType::eGENERIC, uint32_t nbShapes = 0) noexcept;
 
 		~px_aggregate();
 
 		void addActor(physx::PxActor* actor) noexcept;
 		void removeActor(physx::PxActor* actor) noexcept;
 
-		NODISCARD const uint8_t getNbActors() const noexcept { return nbActors; }
+		NODISCARD const uint32_t getNbActors() const noexcept { return nbActors; }
 		NODISCARD const bool isSelfCollision() const noexcept { return selfCollisions; }
 
 	private:
 		physx::PxAggregate* aggregate = nullptr;
 
-		uint8_t nbActors = 0;
+		uint32_t nbActors = 0;
 		bool selfCollisions = true;
 	};
+
+	struct aggregate_builder_desc
+	{
+		float cellSize = 32.0f;
+
+		uint32_t maxActorsPerAggregate = 128U;
+
+		// 0 means maxActorsPerAggregate * 4
+		uint32_t maxShapesPerAggregate = 0U;
+
+		bool dynamicSelfCollisions = true;
+
+		// Dynamic actors which moved further than this from the point they were clustered at are re-clustered by rebalance()
+		float rebalanceDistance = 16.0f;
+	};
+
+	// Groups actors into aggregates by uniform grid cell, so a dense area costs one broadphase proxy per cell.
+	// Static, kinematic and dynamic actors never share an aggregate, each kind gets its PxAggregateFilterHint.
+	struct aggregate_builder
+	{
+		aggregate_builder(const aggregate_builder_desc& desc = aggregate_builder_desc()) noexcept : desc(desc) {}
+
+		aggregate_builder(const aggregate_builder&) = delete;
+		aggregate_builder& operator=(const aggregate_builder&) = delete;
+
+		~aggregate_builder() { release(); }
+
+		// Actors are clustered on the next build() call, they may already be in the scene.
+		void addActor(physx::PxRigidActor* actor) noexcept;
+
+		void removeActor(physx::PxRigidActor* actor) noexcept;
+
+		void build() noexcept;
+
+		void rebalance() noexcept;
+
+		// Removes all aggregates, the actors stay in the scene.
+		void release() noexcept;
+
+		NODISCARD uint32_t getNbAggregates() const noexcept { return nbAggregates; }
+
+		NODISCARD uint32_t getNbActors() const noexcept { return (uint32_t)trackedActors.size(); }
+
+	private:
+		struct tracked_actor
+		{
+			physx::PxAggregate* aggregate = nullptr;
+			physx::PxVec3 anchor;
+			uint64_t cell = 0;
+		};
+
+		NODISCARD uint64_t getCellKey(physx::PxRigidActor* actor, const physx::PxVec3& position) const noexcept;
+
+		void insertActor(physx::PxRigidActor* actor) noexcept;
+
+		void eraseActor(physx::PxRigidActor* actor, const tracked_actor& tracked) noexcept;
+
+	private:
+		aggregate_builder_desc desc;
+
+		std::vector<physx::PxRigidActor*> pendingActors;
+
+		std::unordered_map<uint64_t, std::vector<physx::PxAggregate*>> cells;
+		std::unordered_map<physx::PxRigidActor*, tracked_actor> trackedActors;
+
+		// PxAggregate only reports its shape capacity, not the shapes in use
+		std::unordered_map<physx::PxAggregate*, uint32_t> aggregateShapes;
+
+		uint32_t nbAggregates = 0;
+	};
 }
 
 #endif
\ No newline at end of file
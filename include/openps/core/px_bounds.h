@@ -0,0 +1,36 @@
+#ifndef _OPENPS_BOUNDS_
+#define _OPENPS_BOUNDS_
+
+#include <openps_decl.h>
+
+namespace openps
+{
+	using namespace physx;
+
+	// Caller owned SoA bounds, every array holds at least capacity elements
+	struct bounds_soa
+	{
+		float* minX = nullptr;
+		float* minY = nullptr;
+		float* minZ = nullptr;
+		float* maxX = nullptr;
+		float* maxY = nullptr;
+		float* maxZ = nullptr;
+
+		// The actor's rigidbody handle, 0xFFFFFFFF for actors without one
+		uint32_t* handles = nullptr;
+
+		// Optional
+		PxRigidActor** actors = nullptr;
+
+		uint32_t capacity = 0;
+	};
+
+	// Writes the indices of all bounds intersecting region to outIndices and returns their number
+	uint32_t cullBounds(const bounds_soa& bounds, uint32_t count, const PxBounds3& region, uint32_t* outIndices) noexcept;
+
+	// Plane normals point inside, bounds entirely behind any plane are culled
+	uint32_t cullBounds(const bounds_soa& bounds, uint32_t count, std::span<const PxPlane> planes, uint32_t* outIndices) noexcept;
+}
+
+#endif
\ No newline at end of file
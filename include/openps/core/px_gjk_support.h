@@ -15,6 +15,41 @@ namespace openps
     using px_capsule_support = PxGjkQueryExt::CapsuleSupport;
     using px_convex_support = PxGjkQueryExt::ConvexMeshSupport;
 
+    struct gjk_sweep_hit
+    {
+        PxVec3 position = PxVec3(0.0f);
+        PxVec3 normal = PxVec3(0.0f);
+        float distance = 0.0f;
+    };
+
+    struct gjk_proximity
+    {
+        PxVec3 pointA = PxVec3(0.0f);
+        PxVec3 pointB = PxVec3(0.0f);
+        PxVec3 separatingAxis = PxVec3(0.0f);
+        float separation = 0.0f;
+    };
+
+    // Supports are referenced, not copied, and must outlive the query
+    struct gjk_pair
+    {
+        const px_gjk_support* a = nullptr;
+        const px_gjk_support* b = nullptr;
+
+        PxTransform poseA = PxTransform(PxIdentity);
+        PxTransform poseB = PxTransform(PxIdentity);
+    };
+
+    struct gjk_sweep_query
+    {
+        gjk_pair pair;
+
+        // Direction b moves along relative to a, normalized
+        PxVec3 direction = PxVec3(0.0f, -1.0f, 0.0f);
+        float maxDistance = PX_NB_MAX_RAYCAST_DISTANCE;
+    };
+
+    // Shape vs shape queries on support mappings, independent of any scene
     struct px_gjk_query
     {
         bool overlapSphere(const PxVec3& center1, float radius1, const PxVec3& center2, float radius2) noexcept
@@ -24,21 +59,32 @@ namespace openps
             support1.radius = radius1;
             support2.radius = radius2;
 
-            return overlapImpl(support1, support2, PxTransform(center1), PxTransform(center2));
+            return overlap(support1, support2, PxTransform(center1), PxTransform(center2));
         }
 
         bool overlapBox(const PxVec3& center1, const PxVec3& halfExtents1, const PxVec3& center2, const PxVec3& halfExtents2) noexcept
+        {
+            return overlapBox(PxTransform(center1), halfExtents1, PxTransform(center2), halfExtents2);
+        }
+
+        bool overlapBox(const PxTransform& pose1, const PxVec3& halfExtents1, const PxTransform& pose2, const PxVec3& halfExtents2) noexcept
         {
             px_box_support support1, support2;
 
             support1.halfExtents = halfExtents1;
             support2.halfExtents = halfExtents2;
 
-            return overlapImpl(support1, support2, PxTransform(center1), PxTransform(center2));
+            return overlap(support1, support2, pose1, pose2);
         }
 
         bool overlapCapsule(const PxVec3& center1, float halfHeight1, float radius1,
             const PxVec3& center2, float halfHeight2, float radius2) noexcept
+        {
+            return overlapCapsule(PxTransform(center1), halfHeight1, radius1, PxTransform(center2), halfHeight2, radius2);
+        }
+
+        bool overlapCapsule(const PxTransform& pose1, float halfHeight1, float radius1,
+            const PxTransform& pose2, float halfHeight2, float radius2) noexcept
         {
             px_capsule_support support1, support2;
 
@@ -47,41 +93,46 @@ namespace openps
             support1.radius = radius1;
             support2.radius = radius2;
 
-            return overlapImpl(support1, support2, PxTransform(center1), PxTransform(center2));
+            return overlap(support1, support2, pose1, pose2);
         }
 
         bool raycastShape(const px_gjk_support& supportShape, const PxVec3& shapePose,
             const PxVec3& rayStart, const PxVec3& direction, float maxDist, float& hitDist) noexcept
         {
-            PxVec3 normal, point;
-            return raycastImpl(supportShape, PxTransform(shapePose),
-                rayStart, direction, maxDist, hitDist, normal, point);
+            gjk_sweep_hit hit;
+            const bool result = raycast(supportShape, PxTransform(shapePose), rayStart, direction, maxDist, hit);
+            hitDist = hit.distance;
+            return result;
         }
 
-    private:
-        bool overlapImpl(const PxGjkQuery::Support& a, const PxGjkQuery::Support& b,
-            const PxTransform& poseA, const PxTransform& poseB) noexcept;
-
-        bool sweepImpl(const PxGjkQuery::Support& a, const PxGjkQuery::Support& b,
-            const PxTransform& poseA, const PxTransform& poseB,
-            const PxVec3& unitDir, PxReal maxDist,
-            PxReal& hitDist, PxVec3& n, PxVec3& p) noexcept;
-
-        bool raycastImpl(const PxGjkQuery::Support& shape, const PxTransform& pose,
-            const PxVec3& rayStart, const PxVec3& unitDir, PxReal maxDist,
-            PxReal& hitDist, PxVec3& n, PxVec3& p) noexcept;
-
-        bool proximityInfoImpl(const PxGjkQuery::Support& a, const PxGjkQuery::Support& b,
-            const PxTransform& poseA, const PxTransform& poseB,
-            PxReal contactDistance, PxReal toleranceLength,
-            PxVec3& pointA, PxVec3& pointB, PxVec3& separatingAxis,
-            PxReal& separation) noexcept;
-
-        bool generateContactsImpl(
-            const PxGjkQuery::Support& a, const PxGjkQuery::Support& b,
-            const PxTransform& poseA, const PxTransform& poseB,
-            PxReal contactDistance, PxReal toleranceLength,
-            PxContactBuffer& contactBuffer) noexcept;
+        bool overlap(const px_gjk_support& a, const px_gjk_support& b, const PxTransform& poseA, const PxTransform& poseB) noexcept;
+
+        bool raycast(const px_gjk_support& shape, const PxTransform& pose,
+            const PxVec3& rayStart, const PxVec3& unitDir, float maxDist, gjk_sweep_hit& hit) noexcept;
+
+        // Sweeps b along unitDir against a
+        bool sweep(const px_gjk_support& a, const px_gjk_support& b, const PxTransform& poseA, const PxTransform& poseB,
+            const PxVec3& unitDir, float maxDist, gjk_sweep_hit& hit) noexcept;
+
+        // Closest points, false if the shapes are further apart than contactDistance
+        bool proximityInfo(const px_gjk_support& a, const px_gjk_support& b, const PxTransform& poseA, const PxTransform& poseB,
+            float contactDistance, float toleranceLength, gjk_proximity& result) noexcept;
+
+        bool generateContacts(const px_gjk_support& a, const px_gjk_support& b, const PxTransform& poseA, const PxTransform& poseB,
+            float contactDistance, float toleranceLength, PxContactBuffer& contactBuffer) noexcept;
+
+        // Batched versions split the pairs across the dispatcher threads, the physics dispatcher is used when none is given.
+        // Result spans must be at least as large as the input.
+        void overlapBatch(std::span<const gjk_pair> pairs, std::span<bool> results, PxCpuDispatcher* dispatcher = nullptr) noexcept;
+
+        void sweepBatch(std::span<const gjk_sweep_query> queries, std::span<gjk_sweep_hit> hits, std::span<bool> results,
+            PxCpuDispatcher* dispatcher = nullptr) noexcept;
+
+        void proximityInfoBatch(std::span<const gjk_pair> pairs, float contactDistance, float toleranceLength,
+            std::span<gjk_proximity> proximities, std::span<bool> results, PxCpuDispatcher* dispatcher = nullptr) noexcept;
+
+        void generateContactsBatch(std::span<const gjk_pair> pairs, float contactDistance, float toleranceLength,
+            std::span<PxContactBuffer> contactBuffers, PxCpuDispatcher* dispatcher = nullptr) noexcept;
     };
 }
 
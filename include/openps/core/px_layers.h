@@ -0,0 +1,51 @@
+#ifndef _OPENPS_LAYERS_
+#define _OPENPS_LAYERS_
+
+#include <openps_decl.h>
+
+namespace openps
+{
+	NODISCARD inline constexpr uint32_t layerToMask(uint8_t layer) noexcept { return 1u << layer; }
+
+	// Passed to the simulation filter shader as constant block. Row i holds the layers which collide with layer i.
+	struct collision_matrix
+	{
+		uint32_t rows[PX_NB_COLLISION_LAYERS];
+
+		collision_matrix() noexcept
+		{
+			for (uint32_t i = 0; i < PX_NB_COLLISION_LAYERS; ++i)
+				rows[i] = PX_LAYER_MASK_ALL;
+		}
+
+		void setCollision(uint8_t layer1, uint8_t layer2, bool collide) noexcept
+		{
+			ASSERT(layer1 < PX_NB_COLLISION_LAYERS && layer2 < PX_NB_COLLISION_LAYERS);
+
+			if (collide)
+			{
+				rows[layer1] |= layerToMask(layer2);
+				rows[layer2] |= layerToMask(layer1);
+			}
+			else
+			{
+				rows[layer1] &= ~layerToMask(layer2);
+				rows[layer2] &= ~layerToMask(layer1);
+			}
+		}
+
+		NODISCARD bool canCollide(uint8_t layer1, uint8_t layer2) const noexcept
+		{
+			return (rows[layer1] & layerToMask(layer2)) != 0;
+		}
+
+		// Shapes without filter data (e.g. created by PxCreatePlane) belong to layer 0.
+		NODISCARD bool canCollideMasks(uint32_t layerBits1, uint32_t layerBits2) const noexcept
+		{
+			const uint32_t layer1 = layerBits1 ? physx::PxLowestSetBit(layerBits1) : 0;
+			return (rows[layer1] & (layerBits2 ? layerBits2 : layerToMask(0))) != 0;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef _OPENPS_LINE_OF_SIGHT_
+#define _OPENPS_LINE_OF_SIGHT_
+
+#include <core/px_physics.h>
+
+namespace openps
+{
+	using namespace physx;
+
+	struct line_of_sight_desc
+	{
+		// Endpoints or the cached blocker have to move further than this before a pair is tested again
+		float moveThreshold = 0.1f;
+
+		// Visible pairs are retested at least this often, otherwise new blockers between resting endpoints are never seen
+		uint32_t maxFramesBetweenTests = 10;
+
+		uint32_t layerMask = PX_LAYER_MASK_ALL;
+
+		bool hitTriggers = false;
+	};
+
+	// Answers "can observer see target" for registered pairs. update() only casts rays for pairs which
+	// may have changed and splits them across the query dispatcher threads like physics::raycastBatch.
+	struct line_of_sight
+	{
+		line_of_sight(const line_of_sight_desc& desc = line_of_sight_desc()) noexcept : desc(desc) {}
+
+		// Offsets are in world space, e.g. eye height. Returns the pair index, remove the pair before releasing either actor.
+		uint32_t addPair(const PxRigidActor* observer, const PxRigidActor* target,
+			const PxVec3& observerOffset = PxVec3(0.0f), const PxVec3& targetOffset = PxVec3(0.0f)) noexcept;
+
+		void removePair(uint32_t index) noexcept;
+
+		// Forces a retest of every pair on the next update
+		void invalidate() noexcept;
+
+		void update() noexcept;
+
+		NODISCARD bool isVisible(uint32_t index) const noexcept { return (visibility[index >> 6] >> (index & 63)) & 1; }
+
+		// Bit i is set when pair i was visible at its last test
+		NODISCARD std::span<const uint64_t> getVisibility() const noexcept { return visibility; }
+
+		NODISCARD uint32_t getNbPairs() const noexcept { return (uint32_t)pairs.size() - (uint32_t)freeIndices.size(); }
+
+		// Rays cast by the last update
+		NODISCARD uint32_t getNbTested() const noexcept { return nbTested; }
+
+	private:
+		struct pair
+		{
+			const PxRigidActor* observer = nullptr;
+			const PxRigidActor* target = nullptr;
+
+			PxVec3 observerOffset;
+			PxVec3 targetOffset;
+
+			PxVec3 lastObserver;
+			PxVec3 lastTarget;
+
+			// Only dereferenced while the physics query cache epoch is unchanged
+			const PxRigidActor* blocker = nullptr;
+			PxTransform blockerPose;
+			uint32_t blockerEpoch = 0;
+
+			uint32_t framesSinceTest = 0;
+
+			bool visible = false;
+			bool dirty = true;
+		};
+
+		NODISCARD bool needsTest(pair& p, const PxVec3& from, const PxVec3& to, uint32_t epoch) const noexcept;
+
+	private:
+		line_of_sight_desc desc;
+
+		std::vector<pair> pairs;
+		std::vector<uint32_t> freeIndices;
+
+		std::vector<uint64_t> visibility;
+
+		uint32_t nbTested = 0;
+	};
+}
+
+#endif
\ No newline at end of file
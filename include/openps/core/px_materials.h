@@ -0,0 +1,71 @@
+#ifndef _OPENPS_MATERIALS_
+#define _OPENPS_MATERIALS_
+
+#include <openps_decl.h>
+
+namespace openps
+{
+	using namespace physx;
+
+	struct material_desc
+	{
+		float staticFriction = 0.8f;
+		float dynamicFriction = 0.8f;
+		float restitution = 0.6f;
+
+		PxCombineMode::Enum frictionCombineMode = PxCombineMode::eAVERAGE;
+		PxCombineMode::Enum restitutionCombineMode = PxCombineMode::eAVERAGE;
+	};
+
+	// Shares PxMaterials between actors. Descs are quantized to PX_MATERIAL_QUANTIZATION_STEP,
+	// so nearly equal parameters resolve to the same refcounted entry.
+	struct material_registry
+	{
+		material_registry() = default;
+		material_registry(const material_registry&) = delete;
+		material_registry& operator=(const material_registry&) = delete;
+
+		~material_registry() { release(); }
+
+		NODISCARD PxMaterial* acquire(const material_desc& desc) noexcept;
+
+		// Adds a reference to a material which is already owned by the registry.
+		NODISCARD PxMaterial* acquire(PxMaterial* material) noexcept;
+
+		void release(PxMaterial* material) noexcept;
+
+		// Named materials keep one reference until releaseNamedMaterial or release is called.
+		PxMaterial* createNamedMaterial(const std::string& name, const material_desc& desc) noexcept;
+
+		NODISCARD PxMaterial* getNamedMaterial(const std::string& name) const noexcept;
+
+		void releaseNamedMaterial(const std::string& name) noexcept;
+
+		NODISCARD size_t getNbMaterials() const noexcept { return materials.size(); }
+
+		NODISCARD uint32_t getRefCount(PxMaterial* material) const noexcept;
+
+		void release() noexcept;
+
+	private:
+		struct material_entry
+		{
+			PxMaterial* material = nullptr;
+			uint32_t refCount = 0;
+		};
+
+		NODISCARD static uint64_t makeKey(const material_desc& desc) noexcept;
+
+		// Expects the mutex to be held
+		NODISCARD PxMaterial* acquireInternal(const material_desc& desc) noexcept;
+
+	private:
+		std::unordered_map<uint64_t, material_entry> materials;
+		std::unordered_map<PxMaterial*, uint64_t> materialKeys;
+		std::unordered_map<std::string, PxMaterial*> namedMaterials;
+
+		mutable std::mutex mutex;
+	};
+}
+
+#endif
\ No newline at end of file
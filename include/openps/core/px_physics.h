@@ -6,8 +6,14 @@
 #include <core/px_logger.h>
 #include <core/px_structs.h>
 #include <core/px_wrappers.h>
+#include <core/px_materials.h>
+#include <core/px_shapes.h>
+#include <core/px_layers.h>
+#include <core/px_scene_query.h>
+#include <core/px_bounds.h>
 
 #include <memory/ememory.h>
+#include <memory/eresource.h>
 
 namespace openps
 {
@@ -19,6 +25,30 @@ namespace openps
 	{
 		log_message_func_ptr logMessageFunc;
 		log_error_func_ptr logErrorFunc;
+
+		// Non-empty groups replace the default two-pruner scene query system with one pruner per group.
+		// PxPruningStructures can't be merged into it, so static_world has to be inserted without one.
+		std::vector<layer_group_desc> layerGroups;
+
+		// Keeps the pruners in a BVH, worth it with many groups
+		bool useTreeOfPruners = false;
+
+		// Attributes PhysX allocations to their type names, see getAllocationStats
+		bool trackAllocations = false;
+
+		// Limits the memory committed for per-step scratch. Steps which would exceed it with a refusing callback
+		// simulate without a scratch block.
+		uint64_t scratchBudget = 0;
+		memory_budget_func_ptr scratchBudgetFunc = nullptr;
+		void* scratchBudgetUserData = nullptr;
+
+		memory_trim_policy scratchTrimPolicy;
+
+		// The frame arena is reset at every beginStep
+		memory_trim_policy frameArenaTrimPolicy;
+
+		// Workers for raycastBatch and the other query batches, apart from the simulation dispatcher
+		uint32_t nbQueryThreads = 2U;
 	};
 
 	struct collision_handling_data
@@ -27,6 +57,9 @@ namespace openps
 		uint32_t id2;
 	};
 
+	// Backed by the physics frame arena, valid until the next beginStep
+	using event_queue = std::queue<collision_handling_data, std::pmr::deque<collision_handling_data>>;
+
 	struct physics;
 
 	struct physics_holder
@@ -39,11 +72,11 @@ namespace openps
 		std::set<rigidbody*> actors;
 		std::unordered_map<PxRigidActor*, rigidbody*> actorsMap;
 
-		std::queue<collision_handling_data> collisionQueue;
-		std::queue<collision_handling_data> collisionExitQueue;
+		event_queue collisionQueue;
+		event_queue collisionExitQueue;
 
-		std::queue<collision_handling_data> triggerQueue;
-		std::queue<collision_handling_data> triggerExitQueue;
+		event_queue triggerQueue;
+		event_queue triggerExitQueue;
 
 		uint32_t frameRate = 60U;
 
@@ -60,6 +93,17 @@ namespace openps
 
 		void update(float dt);
 
+		// update() split in two. The write lock is only held inside each call, so scene queries from other threads
+		// can run between them. Such queries see the scene as of the previous endStep: poses, bounds and the
+		// query trees all lag one step behind until endStep returns. Writers (physics_lock_write) on other threads
+		// wait until endStep has fetched the results.
+		void beginStep() noexcept;
+
+		// Waits for the simulation when block is set, otherwise returns false if it hasn't finished yet.
+		bool endStep(bool block = true) noexcept;
+
+		NODISCARD bool isSimulating() const noexcept { return simulating.load(std::memory_order_acquire); }
+
 		void addAggregate(PxAggregate* aggregate) noexcept;
 
 		void removeAggregate(PxAggregate* aggregate) noexcept;
@@ -68,10 +112,25 @@ namespace openps
 
 		void addActor(PxRigidActor* actor) noexcept;
 
+		bool addActors(const PxPruningStructure& pruningStructure) noexcept;
+
+		void addActors(PxRigidActor* const* actors, uint32_t nbActors) noexcept;
+
+		// Fails for collections with a PxPruningStructure while the per-layer scene query system is used
+		bool addCollection(const PxCollection& collection) noexcept;
+
+		void removeActors(PxRigidActor* const* actors, uint32_t nbActors) noexcept;
+
+		// Drops the rigidbodies registered for these actors from actors and actorsMap, the scene isn't touched
+		void unregisterActors(PxRigidActor* const* actors, uint32_t nbActors) noexcept;
+
 		void removeActor(rigidbody* actor) noexcept;
 
 		void reomoveActor(PxRigidActor* actor) noexcept;
 
+		// Drops the shape cache references taken for actor's shared shapes, the actor keeps its own
+		void releaseCachedShapes(PxRigidActor* actor) noexcept;
+
 		void lockRead() noexcept;
 		void unlockRead() noexcept;
 
@@ -80,25 +139,164 @@ namespace openps
 
 		NODISCARD PxPhysics* getPhysicsImpl() const noexcept { return physicsImpl; }
 
+		NODISCARD PxScene* getScene() const noexcept { return scene; }
+
 		NODISCARD PxMaterial* getDefaultMaterial() const noexcept { return defaultMaterial; }
 
-		const raycast_info raycast(rigidbody* rb, const PxVec3& dir, float maxDist = PX_NB_MAX_RAYCAST_DISTANCE, bool hitTriggers = true, uint32_t layerMask = 0) noexcept;
+		NODISCARD PxDefaultCpuDispatcher* getDispatcher() const noexcept { return dispatcher; }
+
+		NODISCARD PxDefaultCpuDispatcher* getQueryDispatcher() const noexcept { return queryDispatcher; }
+
+		NODISCARD material_registry& getMaterialRegistry() noexcept { return materials; }
+
+		NODISCARD shape_cache& getShapeCache() noexcept { return shapes; }
+
+		// Pairs of disabled layers are killed in the filter shader. Changing the matrix refilters all dynamic actors.
+		void setLayerCollision(uint8_t layer1, uint8_t layer2, bool collide) noexcept;
+
+		NODISCARD bool getLayerCollision(uint8_t layer1, uint8_t layer2) const noexcept { return collisionMatrix.canCollide(layer1, layer2); }
+
+		NODISCARD const collision_matrix& getCollisionMatrix() const noexcept { return collisionMatrix; }
+
+		// Null unless physics_desc::layerGroups was set
+		NODISCARD PxCustomSceneQuerySystem* getSceneQuerySystem() const noexcept { return sceneQuerySystem; }
+
+		// Totals over every query_cache used with this physics.
+		NODISCARD query_cache_stats getQueryCacheStats() const noexcept;
+
+		void resetQueryCacheStats() noexcept;
+
+		// Empty unless physics_desc::trackAllocations was set
+		void getAllocationStats(std::vector<allocation_type_stats>& result) const noexcept { allocatorCallback.pool.getTypeStats(result); }
+
+		// Bytes currently allocated by PhysX
+		NODISCARD uint64_t getAllocatedBytes() const noexcept { return allocatorCallback.pool.getLiveBytes(); }
+
+		NODISCARD memory_stats getScratchStats() const noexcept { return allocator.getStats(); }
+
+		// Reset at every beginStep. Use it for per-step temporaries, e.g. overlap_buffer or std::pmr containers
+		// through getFrameResource, and don't keep anything allocated from it past the next beginStep.
+		NODISCARD eallocator& getFrameArena() noexcept { return frameArena; }
+
+		NODISCARD std::pmr::memory_resource* getFrameResource() noexcept { return &frameResource; }
+
+		NODISCARD memory_stats getFrameArenaStats() const noexcept { return frameArena.getStats(); }
+
+		// Logs the maxTypes types with the most live bytes
+		void logAllocationStats(uint32_t maxTypes = 16) const noexcept;
+
+		// Makes every query_cache drop its shape on next use. Called whenever actors or shapes leave the scene.
+		void invalidateQueryCaches() noexcept { queryCacheEpoch.fetch_add(1, std::memory_order_relaxed); }
+
+		// Changes whenever actors or shapes left the scene, pointers cached under an older epoch may dangle.
+		NODISCARD uint32_t getQueryCacheEpoch() const noexcept { return queryCacheEpoch.load(std::memory_order_relaxed); }
+
+		// Casts from the rigidbody's position, skipping the rigidbody itself. The cache belongs to the calling site, see query_cache.
+		const raycast_info raycast(rigidbody* rb, const PxVec3& dir, float maxDist = PX_NB_MAX_RAYCAST_DISTANCE, bool hitTriggers = true, uint32_t layerMask = PX_LAYER_MASK_ALL,
+			query_cache* cache = nullptr) noexcept;
+
+		// Closest hit, ignoreActor is skipped in the prefilter.
+		bool raycast(const PxVec3& origin, const PxVec3& dir, raycast_hit& hit, float maxDist = PX_NB_MAX_RAYCAST_DISTANCE,
+			bool hitTriggers = true, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr, query_cache* cache = nullptr) noexcept;
+
+		// Writes the closest hits.size() hits sorted by distance and returns their number.
+		uint32_t raycastAll(const PxVec3& origin, const PxVec3& dir, std::span<raycast_hit> hits, float maxDist = PX_NB_MAX_RAYCAST_DISTANCE,
+			bool hitTriggers = true, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		// Closest hit per ray. Rays are split across the query dispatcher threads, every range holds the read lock
+		// while it runs, the waiting caller holds none.
+		void raycastBatch(std::span<const raycast_ray> rays, std::span<raycast_hit> hits, bool hitTriggers = true) noexcept;
+
+		// Sweeping. Single variants return the closest blocking hit, *All variants write the closest hits.size() hits sorted by distance.
+		bool sweep(const PxGeometry& geometry, const PxTransform& pose, const PxVec3& dir, float maxDist, sweep_hit& hit,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr, query_cache* cache = nullptr) noexcept;
+
+		uint32_t sweepAll(const PxGeometry& geometry, const PxTransform& pose, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		bool sweepSphere(const PxVec3& center, float radius, const PxVec3& dir, float maxDist, sweep_hit& hit,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		uint32_t sweepSphereAll(const PxVec3& center, float radius, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		bool sweepBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, const PxVec3& dir, float maxDist, sweep_hit& hit,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		uint32_t sweepBoxAll(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		bool sweepCapsule(const PxVec3& center, float radius, float halfHeight, const PxQuat& rotation, const PxVec3& dir, float maxDist, sweep_hit& hit,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		uint32_t sweepCapsuleAll(const PxVec3& center, float radius, float halfHeight, const PxQuat& rotation, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		bool sweepConvex(PxConvexMesh* mesh, const PxMeshScale& scale, const PxTransform& pose, const PxVec3& dir, float maxDist, sweep_hit& hit,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		uint32_t sweepConvexAll(PxConvexMesh* mesh, const PxMeshScale& scale, const PxTransform& pose, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		// Closest hit per query, split across the query dispatcher threads like raycastBatch.
+		void sweepBatch(std::span<const sweep_query> queries, std::span<sweep_hit> hits, bool hitTriggers = false) noexcept;
+
+		// Nearest shape within maxDist of point. Overlap candidates are refined with PxGeometryQuery::pointDistance,
+		// so planes, heightfields and non-BVH34 meshes are never reported.
+		bool closestPoint(const PxVec3& point, float maxDist, distance_hit& hit,
+			bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, const PxRigidActor* ignoreActor = nullptr) noexcept;
+
+		// Nearest shape per query, split across the query dispatcher threads like raycastBatch.
+		void closestPointBatch(std::span<const distance_query> queries, std::span<distance_hit> hits, bool hitTriggers = false) noexcept;
+
+		// World bounds of every rigid actor in the scene, or only of those moved by the last step, split across the query
+		// dispatcher threads like raycastBatch. Slots of actors removed meanwhile get empty bounds and no actor.
+		// Writes at most out.capacity entries and returns their number, see cullBounds for region queries.
+		uint32_t exportBounds(bounds_soa& out, bool activeOnly = false) noexcept;
+
+		// Capsule sweeps along -up for every probe, split across the query dispatcher threads like raycastBatch.
+		// Probes starting inside the ground are grounded with a negative distance.
+		void groundProbeBatch(std::span<const ground_probe> probes, ground_probe_results& results,
+			const PxVec3& up = PxVec3(0.0f, 1.0f, 0.0f), bool hitTriggers = false) noexcept;
 
 		// Checking
-		const bool checkBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, bool hitTriggers = false, uint32_t layerMask = 0) noexcept;
+		const bool checkBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, query_cache* cache = nullptr) noexcept;
+
+		const bool checkSphere(const PxVec3& center, const float radius, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, query_cache* cache = nullptr) noexcept;
+
+		const bool checkCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL, query_cache* cache = nullptr) noexcept;
+
+		// Overlapping. The handle is the actor's userData, compound actors are reported once. Span variants write at most
+		// results.size() handles, buffer variants grow until their storage can't, both return the total number of overlapping actors.
+		uint32_t overlap(const PxGeometry& geometry, const PxTransform& pose, std::span<uint32_t*> results, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
+
+		uint32_t overlap(const PxGeometry& geometry, const PxTransform& pose, overlap_buffer& results, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
+
+		// Counts overlapping actors without collecting handles.
+		uint32_t overlapCount(const PxGeometry& geometry, const PxTransform& pose, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
+
+		uint32_t overlapSphere(const PxVec3& center, const float radius, std::span<uint32_t*> results, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
+
+		uint32_t overlapSphere(const PxVec3& center, const float radius, overlap_buffer& results, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
+
+		uint32_t overlapBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, std::span<uint32_t*> results, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
+
+		uint32_t overlapBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, overlap_buffer& results, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
 
-		const bool checkSphere(const PxVec3& center, const float radius, bool hitTriggers = false, uint32_t layerMask = 0) noexcept;
+		uint32_t overlapCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, std::span<uint32_t*> results, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
 
-		const bool checkCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, bool hitTriggers = false, uint32_t layerMask = 0) noexcept;
+		uint32_t overlapCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, overlap_buffer& results, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
 
-		// Overlapping
-		const overlap_info overlapCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, bool hitTriggers = false, uint32_t layerMask = 0) noexcept;
+		const overlap_info overlapCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
 
-		const overlap_info overlapBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, bool hitTriggers = false, uint32_t layerMask = 0) noexcept;
+		const overlap_info overlapBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
 
-		const overlap_info overlapSphere(const PxVec3& center, const float radius, bool hitTriggers = false, uint32_t layerMask = 0) noexcept;
+		const overlap_info overlapSphere(const PxVec3& center, const float radius, bool hitTriggers = false, uint32_t layerMask = PX_LAYER_MASK_ALL) noexcept;
 
 	private:
+		template<typename HitType, typename ResultType>
+		friend struct closest_hits_collector;
+
 		void initialize() noexcept;
 
 		void release() noexcept;
@@ -107,6 +305,24 @@ namespace openps
 
 		void clearInternalQueues() noexcept;
 
+		// The event queues and arrays live in the frame arena, they are destroyed before it is reset and rebuilt after
+		void destroyFrameContainers() noexcept;
+
+		void constructFrameContainers(std::pmr::memory_resource* resource) noexcept;
+
+		NODISCARD rigidbody* findRigidbody(const PxRigidActor* actor) const noexcept;
+
+		// closestPoint without the lock, the caller holds it
+		bool closestPointInternal(const PxVec3& point, float maxDist, distance_hit& hit, bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept;
+
+		void fillHit(const PxRaycastHit& hit, raycast_hit& result) const noexcept;
+
+		void fillHit(const PxSweepHit& hit, sweep_hit& result) const noexcept;
+
+		NODISCARD const PxQueryCache* beginCachedQuery(query_cache* cache) noexcept;
+
+		void endCachedQuery(query_cache* cache, const PxActorShape* hit) noexcept;
+
 	private:
 		PxScene* scene = nullptr;
 
@@ -114,6 +330,18 @@ namespace openps
 
 		PxMaterial* defaultMaterial = nullptr;
 
+		layer_pruner_adapter sceneQueryAdapter;
+
+		PxCustomSceneQuerySystem* sceneQuerySystem = nullptr;
+
+		bool useTreeOfPruners = false;
+
+		material_registry materials;
+
+		shape_cache shapes;
+
+		collision_matrix collisionMatrix;
+
 		PxPvd* pvd = nullptr;
 
 		PxCudaContextManager* cudaContextManager = nullptr;
@@ -122,6 +350,8 @@ namespace openps
 
 		PxDefaultCpuDispatcher* dispatcher = nullptr;
 
+		PxDefaultCpuDispatcher* queryDispatcher = nullptr;
+
 		PxDefaultAllocator defaultAllocatorCallback;
 
 		allocator_callback allocatorCallback;
@@ -132,12 +362,30 @@ namespace openps
 
 		query_filter queryFilter;
 
+		std::atomic<uint32_t> queryCacheEpoch = 0;
+
+		std::atomic<uint64_t> queryCacheQueries = 0;
+		std::atomic<uint64_t> queryCacheHits = 0;
+		std::atomic<uint64_t> queryCacheMisses = 0;
+		std::atomic<uint64_t> queryCacheInvalidations = 0;
+
 		simulation_filter_callback simulationFilterCallback;
 		simulation_event_callback simulationCallback;
 
 		uint32_t nbCPUDispatcherThreads = 4U;
+		uint32_t nbQueryThreads = 2U;
 
 		eallocator allocator;
+
+		eallocator frameArena;
+		eallocator_resource frameResource{ &frameArena };
+
+		std::atomic<bool> simulating = false;
+
+		// Lets lockWrite wait for a running step instead of writing into it
+		std::mutex stepMutex;
+		std::condition_variable stepFinished;
+		std::atomic<std::thread::id> stepThread;
 	};
 
 	struct physics_lock
@@ -0,0 +1,56 @@
+#ifndef _OPENPS_SCENE_QUERY_
+#define _OPENPS_SCENE_QUERY_
+
+#include <openps_decl.h>
+
+namespace openps
+{
+	using namespace physx;
+
+	// One pruner of the custom scene query system. Shapes go to the first group of their actor kind whose mask contains their layer.
+	struct layer_group_desc
+	{
+		uint32_t layerMask = PX_LAYER_MASK_ALL;
+
+		bool dynamic = false;
+
+		PxPruningStructureType::Enum structure = PxPruningStructureType::eDYNAMIC_AABB_TREE;
+
+		uint32_t preallocated = 0;
+	};
+
+	// Maps shapes to per-layer-group pruners and skips pruners which can't contain a layer of the query.
+	// Shapes without a layer and layers outside every group go to a static and a dynamic fallback pruner which are always searched.
+	struct layer_pruner_adapter : PxCustomSceneQuerySystemAdapter
+	{
+		void setGroups(std::span<const layer_group_desc> newGroups) noexcept { groups.assign(newGroups.begin(), newGroups.end()); }
+
+		NODISCARD bool isEnabled() const noexcept { return !groups.empty(); }
+
+		NODISCARD PxCustomSceneQuerySystem* create(bool usesTreeOfPruners = false) noexcept;
+
+		PxU32 getPrunerIndex(const PxRigidActor& actor, const PxShape& shape) const override;
+
+		bool processPruner(PxU32 prunerIndex, const PxQueryThreadContext* context, const PxQueryFilterData& filterData, PxQueryFilterCallback* filterCall) const override;
+
+		NODISCARD uint32_t getNbPruners() const noexcept { return (uint32_t)pruners.size(); }
+
+	private:
+		struct pruner
+		{
+			uint32_t layerMask;
+			bool dynamic;
+			bool fallback;
+		};
+
+		std::vector<layer_group_desc> groups;
+
+		// Indexed by the pruner index returned from addPruner
+		std::vector<pruner> pruners;
+
+		uint32_t staticFallback = 0;
+		uint32_t dynamicFallback = 0;
+	};
+}
+
+#endif
\ No newline at end of file
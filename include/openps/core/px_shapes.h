@@ -0,0 +1,77 @@
+#ifndef _OPENPS_SHAPES_
+#define _OPENPS_SHAPES_
+
+#include <openps_decl.h>
+
+namespace openps
+{
+	using namespace physx;
+
+	struct shape_key
+	{
+		uint32_t geometryType = 0;
+		uint32_t shapeFlags = 0;
+
+		float params[8] = {};
+
+		// Shared shapes carry their local pose, the last float is padding
+		float localPose[8] = {};
+
+		uint32_t simulationFilterData[4] = {};
+		uint32_t queryFilterData[4] = {};
+
+		const void* mesh = nullptr;
+		const PxMaterial* material = nullptr;
+
+		NODISCARD bool operator==(const shape_key& other) const noexcept { return memcmp(this, &other, sizeof(shape_key)) == 0; }
+	};
+
+	struct shape_key_hash
+	{
+		NODISCARD size_t operator()(const shape_key& key) const noexcept;
+	};
+
+	// Shares non-exclusive PxShapes between actors with identical geometry, material, filter data, local pose and flags.
+	// The cache keeps one reference on every shape, attached actors hold the others. Every acquire has to be paired with
+	// a release once the actor detaches the shape or leaves the scene for good, the entry goes away with the last one.
+	struct shape_cache
+	{
+		shape_cache() = default;
+		shape_cache(const shape_cache&) = delete;
+		shape_cache& operator=(const shape_cache&) = delete;
+
+		~shape_cache() { release(); }
+
+		NODISCARD PxShape* acquire(const PxGeometry& geometry, PxMaterial& material,
+			const PxFilterData& simulationFilterData = PxFilterData(), const PxFilterData& queryFilterData = PxFilterData(),
+			const PxTransform& localPose = PxTransform(PxIdentity),
+			PxShapeFlags shapeFlags = PxShapeFlag::eVISUALIZATION | PxShapeFlag::eSCENE_QUERY_SHAPE | PxShapeFlag::eSIMULATION_SHAPE) noexcept;
+
+		// Drops one acquire of a cached shape, shapes the cache doesn't own are ignored.
+		void release(PxShape* shape) noexcept;
+
+		// Releases shapes which are not attached to any actor anymore.
+		void trim() noexcept;
+
+		NODISCARD size_t getNbShapes() const noexcept { return shapes.size(); }
+
+		void release() noexcept;
+
+	private:
+		struct shape_entry
+		{
+			PxShape* shape = nullptr;
+			uint32_t refCount = 0;
+		};
+
+		void erase(std::unordered_map<shape_key, shape_entry, shape_key_hash>::iterator iter) noexcept;
+
+	private:
+		std::unordered_map<shape_key, shape_entry, shape_key_hash> shapes;
+		std::unordered_map<PxShape*, shape_key> shapeKeys;
+
+		std::mutex mutex;
+	};
+}
+
+#endif
\ No newline at end of file
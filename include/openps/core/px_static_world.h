@@ -0,0 +1,61 @@
+#ifndef _OPENPS_STATIC_WORLD_
+#define _OPENPS_STATIC_WORLD_
+
+#include <future>
+
+#include <core/px_physics.h>
+
+namespace openps
+{
+	using namespace physx;
+
+	// Bulk loader for static level geometry. The scene-query tree of all actors is precomputed
+	// into a PxPruningStructure off-thread and the whole set is inserted into the scene at once.
+	struct static_world
+	{
+		static_world() = default;
+		static_world(const static_world&) = delete;
+		static_world& operator=(const static_world&) = delete;
+
+		~static_world() { release(); }
+
+		// Actors must be static and must not be in a scene yet (see createRigidbodyActor's addToScene).
+		void buildAsync(std::vector<PxRigidActor*> actors) noexcept;
+
+		NODISCARD bool isReady() const noexcept;
+
+		// Waits for the build if needed and adds all actors to the scene.
+		bool insert() noexcept;
+
+		// Writes the built pruning structure with its actors, shapes and materials to a binary file.
+		bool save(const char* path) noexcept;
+
+		// Loads a file written by save() and adds its content to the scene.
+		bool load(const char* path) noexcept;
+
+		// Removes the actors from the scene and unregisters their rigidbodies. Only actors loaded from a file are released, built actors belong to the caller.
+		void release() noexcept;
+
+		NODISCARD uint32_t getNbActors() const noexcept { return (uint32_t)actors.size(); }
+
+	private:
+		bool waitForBuild() noexcept;
+
+	private:
+		std::vector<PxRigidActor*> actors;
+
+		std::future<PxPruningStructure*> buildTask;
+
+		PxPruningStructure* pruningStructure = nullptr;
+
+		PxCollection* collection = nullptr;
+
+		PxSerializationRegistry* serializationRegistry = nullptr;
+
+		std::unique_ptr<uint8_t[]> serializedMemory;
+
+		bool inScene = false;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -3,9 +3,45 @@
 
 #include <openps_decl.h>
 
+#include <memory/ememory.h>
+
 namespace openps
 {
 	struct rigidbody;
+	struct physics;
+
+	struct query_cache_stats
+	{
+		uint64_t queries = 0;
+
+		// The cached shape produced the result again
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+
+		// Dropped because actors or shapes were removed from the scene since the cache was filled
+		uint64_t invalidations = 0;
+
+		NODISCARD float getHitRate() const noexcept { return queries ? (float)hits / (float)queries : 0.0f; }
+	};
+
+	// Remembers the last hit shape of one query site and passes it to PhysX as PxQueryCache, so temporally coherent
+	// queries test it before traversing the pruners. Not thread safe, use one cache per site and thread.
+	struct query_cache
+	{
+		void reset() noexcept { cache = physx::PxQueryCache(); }
+
+		NODISCARD const query_cache_stats& getStats() const noexcept { return stats; }
+
+		void resetStats() noexcept { stats = query_cache_stats(); }
+
+	private:
+		physx::PxQueryCache cache;
+		uint32_t epoch = 0;
+
+		query_cache_stats stats;
+
+		friend struct physics;
+	};
 
 	struct raycast_info
 	{
@@ -16,11 +52,200 @@ namespace openps
 		physx::PxVec3 position = physx::PxVec3(0.0f);
 	};
 
+	struct raycast_ray
+	{
+		physx::PxVec3 origin = physx::PxVec3(0.0f);
+		physx::PxVec3 direction = physx::PxVec3(0.0f, -1.0f, 0.0f);
+
+		float maxDistance = PX_NB_MAX_RAYCAST_DISTANCE;
+
+		uint32_t layerMask = PX_LAYER_MASK_ALL;
+
+		query_cache* cache = nullptr;
+	};
+
+	struct raycast_hit
+	{
+		rigidbody* actor = nullptr;
+		physx::PxRigidActor* rigidActor = nullptr;
+
+		physx::PxVec3 position = physx::PxVec3(0.0f);
+		physx::PxVec3 normal = physx::PxVec3(0.0f);
+
+		float distance = 0.0f;
+
+		float u = 0.0f;
+		float v = 0.0f;
+
+		uint32_t faceIndex = 0xFFFFFFFF;
+
+		physx::PxMaterial* material = nullptr;
+
+		NODISCARD bool hasHit() const noexcept { return rigidActor != nullptr; }
+	};
+
+	struct sweep_query
+	{
+		physx::PxGeometryHolder geometry;
+		physx::PxTransform pose = physx::PxTransform(physx::PxIdentity);
+
+		physx::PxVec3 direction = physx::PxVec3(0.0f, -1.0f, 0.0f);
+		float maxDistance = PX_NB_MAX_RAYCAST_DISTANCE;
+
+		uint32_t layerMask = PX_LAYER_MASK_ALL;
+
+		const physx::PxRigidActor* ignoreActor = nullptr;
+
+		query_cache* cache = nullptr;
+	};
+
+	struct sweep_hit
+	{
+		rigidbody* actor = nullptr;
+		physx::PxRigidActor* rigidActor = nullptr;
+
+		physx::PxVec3 position = physx::PxVec3(0.0f);
+		physx::PxVec3 normal = physx::PxVec3(0.0f);
+
+		float distance = 0.0f;
+
+		uint32_t faceIndex = 0xFFFFFFFF;
+
+		physx::PxMaterial* material = nullptr;
+
+		// The swept shape already overlapped the hit at its start pose
+		bool initialOverlap = false;
+
+		NODISCARD bool hasHit() const noexcept { return rigidActor != nullptr; }
+	};
+
+	struct distance_query
+	{
+		physx::PxVec3 point = physx::PxVec3(0.0f);
+		float maxDistance = 1.0f;
+
+		uint32_t layerMask = PX_LAYER_MASK_ALL;
+
+		const physx::PxRigidActor* ignoreActor = nullptr;
+	};
+
+	struct distance_hit
+	{
+		rigidbody* actor = nullptr;
+		physx::PxRigidActor* rigidActor = nullptr;
+		physx::PxShape* shape = nullptr;
+
+		// Equals the query point when it is inside the shape
+		physx::PxVec3 closestPoint = physx::PxVec3(0.0f);
+		float distance = 0.0f;
+
+		NODISCARD bool hasHit() const noexcept { return rigidActor != nullptr; }
+	};
+
+	// Upright capsule of one agent swept down by maxStep. Faces steeper than maxSlopeAngle aren't walkable.
+	struct ground_probe
+	{
+		physx::PxVec3 center = physx::PxVec3(0.0f);
+
+		float radius = 0.5f;
+		float halfHeight = 0.5f;
+
+		float maxStep = 0.3f;
+		float maxSlopeAngle = physx::PxPi / 4.0f;
+
+		uint32_t layerMask = PX_LAYER_MASK_ALL;
+
+		const physx::PxRigidActor* ignoreActor = nullptr;
+	};
+
+	// Caller owned SoA results, one element per probe
+	struct ground_probe_results
+	{
+		// The ground's rigidbody handle, 0xFFFFFFFF without ground or for actors without one
+		uint32_t* handles = nullptr;
+
+		physx::PxVec3* normals = nullptr;
+
+		// Negative when the probe started inside the ground, the penetration depth along the normal
+		float* distances = nullptr;
+
+		bool* grounded = nullptr;
+		bool* walkable = nullptr;
+
+		uint32_t capacity = 0;
+	};
+
 	struct overlap_info
 	{
 		bool isOverlapping = false;
 		std::vector<uint32_t*> results{};
 	};
+
+	// Growable overlap results without a size limit. Storage is kept between queries, with an arena it is bump allocated
+	// and must not be used past the arena's next reset.
+	struct overlap_buffer
+	{
+		overlap_buffer(eallocator* arena = nullptr) noexcept : arena(arena) {}
+		overlap_buffer(const overlap_buffer&) = delete;
+		overlap_buffer& operator=(const overlap_buffer&) = delete;
+
+		~overlap_buffer()
+		{
+			if (!arena)
+				free(handles);
+		}
+
+		void clear() noexcept { count = 0; }
+
+		// Keeps the old storage and returns false when the arena refuses or the heap is out of memory
+		bool reserve(uint32_t newCapacity) noexcept
+		{
+			if (newCapacity <= capacity)
+				return true;
+
+			uint32_t** newHandles = nullptr;
+
+			if (arena)
+			{
+				newHandles = arena->allocateLocal<uint32_t*>(newCapacity);
+				if (newHandles && count)
+					memcpy(newHandles, handles, count * sizeof(uint32_t*));
+			}
+			else
+				newHandles = (uint32_t**)realloc(handles, newCapacity * sizeof(uint32_t*));
+
+			if (!newHandles)
+				return false;
+
+			handles = newHandles;
+			capacity = newCapacity;
+
+			return true;
+		}
+
+		// Drops the handle if the storage can't grow
+		bool push(uint32_t* handle) noexcept
+		{
+			if (count == capacity && !reserve(max(capacity * 2, 64u)))
+				return false;
+
+			handles[count++] = handle;
+			return true;
+		}
+
+		NODISCARD uint32_t size() const noexcept { return count; }
+
+		NODISCARD uint32_t* operator[](uint32_t index) const noexcept { return handles[index]; }
+
+		NODISCARD std::span<uint32_t* const> results() const noexcept { return { handles, count }; }
+
+	private:
+		uint32_t** handles = nullptr;
+		uint32_t count = 0;
+		uint32_t capacity = 0;
+
+		eallocator* arena = nullptr;
+	};
 }
 
 #endif
\ No newline at end of file
@@ -41,22 +41,91 @@ namespace openps
 		virtual void run() { call(args); }
 
 	private:
-		template <typename... Args, int... Is>
-		void call(std::tuple<Args...>& tup, helper::index<Is...>) noexcept
+		template <typename... CallArgs, int... Is>
+		void call(std::tuple<CallArgs...>& tup, helper::index<Is...>) noexcept
 		{
 			func(std::get<Is>(tup)...);
 		}
 
-		template <typename... Args>
-		void call(std::tuple<Args...>& tup) noexcept
+		template <typename... CallArgs>
+		void call(std::tuple<CallArgs...>& tup) noexcept
 		{
-			call(tup, helper::gen_seq<sizeof...(Args)>{});
+			call(tup, helper::gen_seq<sizeof...(CallArgs)>{});
 		}
 
 	protected:
 		std::tuple<Args...> args;
 		std::function<Func(Args...)> func;
 	};
+
+	template<typename Func>
+	struct parallel_for_task : physx::PxLightCpuTask
+	{
+		virtual const char* getName() const { return "OpenPS Parallel For"; }
+
+		virtual void run()
+		{
+			(*func)(begin, end);
+		}
+
+		// The dispatcher calls release after run. The tasks live on parallelFor's stack, which may be gone as soon
+		// as pending drops, so this is the last access to the task.
+		virtual void release()
+		{
+			std::atomic<uint32_t>* counter = pending;
+			counter->fetch_sub(1, std::memory_order_release);
+		}
+
+		Func* func = nullptr;
+		uint32_t begin = 0;
+		uint32_t end = 0;
+		std::atomic<uint32_t>* pending = nullptr;
+	};
+
+	// Splits [0, count) into ranges of at least grainSize elements and runs func(begin, end) for each of them
+	// on the dispatcher worker threads. The calling thread processes the first range and waits for the rest.
+	// Scene locks belong inside func, so every worker holds its own: PhysX checks the lock per thread. The caller
+	// must not hold one while waiting, a range blocked behind a queued writer would never finish. Scene query
+	// batches run on physics::getQueryDispatcher, the simulation dispatcher stays free for the step.
+	template<typename Func>
+	void parallelFor(physx::PxCpuDispatcher* dispatcher, uint32_t count, uint32_t grainSize, Func&& func) noexcept
+	{
+		if (count == 0)
+			return;
+
+		const uint32_t nbWorkers = dispatcher ? dispatcher->getWorkerCount() : 0U;
+
+		uint32_t nbRanges = bucketize(count, max(grainSize, 1U));
+		nbRanges = min(nbRanges, min(nbWorkers + 1U, (uint32_t)PX_MAX_PARALLEL_RANGES));
+
+		if (nbRanges <= 1U)
+		{
+			func(0U, count);
+			return;
+		}
+
+		const uint32_t rangeSize = bucketize(count, nbRanges);
+		nbRanges = bucketize(count, rangeSize);
+
+		using func_type = std::remove_reference_t<Func>;
+
+		std::atomic<uint32_t> pending{ nbRanges - 1U };
+		parallel_for_task<func_type> tasks[PX_MAX_PARALLEL_RANGES];
+
+		for (uint32_t i = 1; i < nbRanges; ++i)
+		{
+			tasks[i].func = &func;
+			tasks[i].begin = i * rangeSize;
+			tasks[i].end = min(count, (i + 1U) * rangeSize);
+			tasks[i].pending = &pending;
+			dispatcher->submitTask(tasks[i]);
+		}
+
+		func(0U, rangeSize);
+
+		while (pending.load(std::memory_order_acquire) != 0U)
+			std::this_thread::yield();
+	}
 }
 
 #endif
\ No newline at end of file
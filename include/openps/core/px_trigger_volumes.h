@@ -0,0 +1,97 @@
+#ifndef _OPENPS_TRIGGER_VOLUMES_
+#define _OPENPS_TRIGGER_VOLUMES_
+
+#include <core/px_physics.h>
+
+namespace openps
+{
+	using namespace physx;
+
+	// Sphere and AABB trigger zones tested against rigidbody positions without PhysX shapes or broadphase proxies.
+	// Zones are bucketed into a uniform grid whose cells keep their zones as SoA, so a body tests four zones per SSE op.
+	// Events use the physics::triggerQueue layout with id1 as the rigidbody handle and id2 as the zone handle.
+	struct trigger_volumes
+	{
+		trigger_volumes(float cellSize = 16.0f) noexcept : cellSize(cellSize), invCellSize(1.0f / cellSize) {}
+
+		uint32_t addSphere(uint32_t handle, const PxVec3& center, float radius) noexcept;
+
+		uint32_t addBox(uint32_t handle, const PxBounds3& bounds) noexcept;
+
+		void removeZone(uint32_t zone) noexcept;
+
+		void addBody(const rigidbody* rb) noexcept;
+
+		void removeBody(const rigidbody* rb) noexcept;
+
+		// Call after physics::update, reads the body poses and fills the event queues.
+		void update() noexcept;
+
+		NODISCARD uint32_t getNbZones() const noexcept { return (uint32_t)(zones.size() - freeZones.size() - removedZones.size()); }
+
+		std::queue<collision_handling_data> triggerQueue;
+		std::queue<collision_handling_data> triggerExitQueue;
+
+	private:
+		enum class zone_type : uint8_t
+		{
+			None,
+			Sphere,
+			Box
+		};
+
+		struct zone
+		{
+			PxBounds3 bounds;
+			PxVec3 center;
+			float radius = 0.0f;
+
+			uint32_t handle = 0;
+			zone_type type = zone_type::None;
+		};
+
+		// Zone bounds of one grid cell, padded to a multiple of four with zones nothing can be inside of
+		struct grid_cell
+		{
+			std::vector<float> sphereX, sphereY, sphereZ, sphereRadiusSq;
+			std::vector<uint32_t> spheres;
+
+			std::vector<float> boxMinX, boxMinY, boxMinZ, boxMaxX, boxMaxY, boxMaxZ;
+			std::vector<uint32_t> boxes;
+		};
+
+		struct tracked_body
+		{
+			const rigidbody* rb = nullptr;
+
+			// Sorted zone indices of the last and the current update
+			std::vector<uint32_t> inside;
+			std::vector<uint32_t> current;
+		};
+
+		NODISCARD uint64_t cellKey(int32_t x, int32_t y, int32_t z) const noexcept;
+
+		NODISCARD int32_t cellCoord(float v) const noexcept { return (int32_t)PxFloor(v * invCellSize); }
+
+		uint32_t addZone(const zone& newZone) noexcept;
+
+		void rebuild() noexcept;
+
+		void testCell(const grid_cell& cell, const PxVec3& position, std::vector<uint32_t>& result) const noexcept;
+
+	private:
+		float cellSize;
+		float invCellSize;
+
+		std::vector<zone> zones;
+		std::vector<uint32_t> freeZones;
+		std::vector<uint32_t> removedZones;
+
+		std::unordered_map<uint64_t, grid_cell> grid;
+		bool gridDirty = false;
+
+		std::vector<tracked_body> bodies;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -11,6 +11,9 @@
 #include <ecs/px_rigidbody.h>
 #include <ecs/px_colliders.h>
 
+#include <memory/epool.h>
+#include <memory/eresource.h>
+
 namespace openps
 {
 	using namespace physx;
@@ -20,6 +23,8 @@ namespace openps
 		void* allocate(size_t size, const char* typeName, const char* filename, int line) override;
 
 		void deallocate(void* ptr) override;
+
+		epool_allocator pool;
 	};
 
 	struct simulation_filter_callback : PxSimulationFilterCallback
@@ -51,6 +56,8 @@ namespace openps
 		PxQueryHitType::Enum preFilter(const PxFilterData& filterData, const PxShape* shape, const PxRigidActor* actor, PxHitFlags& queryFlags) override;
 
 		PxQueryHitType::Enum postFilter(const PxFilterData& filterData, const PxQueryHit& hit, const PxShape* shape, const PxRigidActor* actor) override;
+
+		const PxRigidActor* ignoreActor = nullptr;
 	};
 
 	struct profiler_callback : PxProfilerCallback
@@ -119,6 +126,9 @@ namespace openps
 
 		void onColliderRemoved(rigidbody* collider);
 
+		// Drops the arrays' storage without touching it and moves them to resource. Called before the frame arena is reset.
+		void rebuild(std::pmr::memory_resource* resource) noexcept;
+
 		void onConstraintBreak(physx::PxConstraintInfo* constraints, physx::PxU32 count) override { /*std::cout << "onConstraintBreak\n";*/ }
 		void onWake(physx::PxActor** actors, physx::PxU32 count) override { /*std::cout << "onWake\n";*/ }
 		void onSleep(physx::PxActor** actors, physx::PxU32 count) override { /*std::cout << "onSleep\n";*/ }
@@ -126,15 +136,15 @@ namespace openps
 		void onAdvance(const physx::PxRigidBody* const* bodyBuffer, const physx::PxTransform* poseBuffer, const physx::PxU32 count) override { /*std::cout << "onAdvance\n";*/ }
 		void onContact(const PxContactPairHeader& pairHeader, const PxContactPair* pairs, PxU32 nbPairs) override;
 	
-		PxArray<collision> newCollisions;
+		std::pmr::vector<collision> newCollisions;
 
-		PxArray<rigidbody*> kinematicsToRemoveFlag;
+		std::pmr::vector<rigidbody*> kinematicsToRemoveFlag;
 
-		PxArray<collision> removedCollisions;
+		std::pmr::vector<collision> removedCollisions;
 
-		PxArray<colliders_pair> newTriggerPairs;
+		std::pmr::vector<colliders_pair> newTriggerPairs;
 
-		PxArray<colliders_pair> lostTriggerPairs;
+		std::pmr::vector<colliders_pair> lostTriggerPairs;
 	};
 
 	PxTriangleMesh* createTriangleMesh(PxTriangleMeshDesc desc);
@@ -207,7 +217,7 @@ namespace openps
 		}
 	};
 
-	PxRigidActor* createRigidbodyActor(rigidbody* rb, collider_base* collider, const PxTransform& trs) noexcept;
+	PxRigidActor* createRigidbodyActor(rigidbody* rb, collider_base* collider, const PxTransform& trs, bool addToScene = true) noexcept;
 }
 
 #endif
\ No newline at end of file
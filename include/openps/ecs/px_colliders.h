@@ -16,7 +16,8 @@ namespace openps
 		TriangleMesh,
 		ConvexMesh,
 		Plane,
-		BoundingBox
+		BoundingBox,
+		Compound
 	};
 
 	template<typename T_>
@@ -100,9 +101,9 @@ namespace openps
 
 		virtual ~collider_base() {};
 
-		NODISCARD PxGeometry* getGeometry() noexcept { return geometry; }
+		NODISCARD PxGeometry* getGeometry() noexcept { return geometry.getType() != PxGeometryType::eINVALID ? &geometry.any() : nullptr; }
 
-		virtual void release() { RELEASE_PTR(geometry) }
+		virtual void release() { geometry = PxGeometryHolder(); }
 
 		NODISCARD collider_type getType() const noexcept { return type; }
 
@@ -117,7 +118,7 @@ namespace openps
 	protected:
 		collider_type type = collider_type::None;
 
-		PxGeometry* geometry = nullptr;
+		PxGeometryHolder geometry;
 	};
 
 	struct box_collider : collider_base
@@ -258,6 +259,43 @@ namespace openps
 
 		PxRigidStatic* plane = nullptr;
 	};
+
+	struct compound_child
+	{
+		collider_base* collider = nullptr;
+
+		PxTransform localPose = PxTransform(PxIdentity);
+
+		// Overrides the rigidbody material when set
+		PxMaterial* material = nullptr;
+
+		float density = 1.0f;
+	};
+
+	// Builds one actor with a shape per child. Mass and inertia of dynamic bodies are computed from all children.
+	struct compound_collider : collider_base
+	{
+		compound_collider() noexcept
+		{
+			type = collider_type::Compound;
+		}
+
+		compound_collider(const std::vector<compound_child>& childColliders) noexcept : children(childColliders)
+		{
+			type = collider_type::Compound;
+		}
+
+		virtual ~compound_collider() {}
+
+		void addChild(collider_base* collider, const PxTransform& localPose, PxMaterial* material = nullptr, float density = 1.0f)
+		{
+			children.push_back(compound_child{ collider, localPose, material, density });
+		}
+
+		PxGeometry* createGeometry() override { return nullptr; }
+
+		std::vector<compound_child> children;
+	};
 };
 
 #endif
\ No newline at end of file
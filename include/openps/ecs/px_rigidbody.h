@@ -3,6 +3,8 @@
 
 #include <openps_decl.h>
 #include <core/px_logger.h>
+#include <core/px_layers.h>
+#include <core/px_structs.h>
 #include <ecs/px_colliders.h>
 
 namespace openps
@@ -54,6 +56,26 @@ namespace openps
 
 		NODISCARD PxRigidActor* getRigidActor() const noexcept { return actor; }
 
+		NODISCARD rigidbody_type getType() const noexcept { return type; }
+
+		NODISCARD PxMaterial* getMaterial() const noexcept { return material; }
+
+		// Must be called before createRigidbodyActor. The material has to be owned by physics::getMaterialRegistry.
+		void setMaterial(PxMaterial* newMaterial) noexcept;
+
+		NODISCARD uint8_t getLayer() const noexcept { return layer; }
+
+		void setLayer(uint8_t newLayer) noexcept;
+
+		// Layers this body is allowed to collide with, on top of the physics collision matrix
+		NODISCARD PxU32 getFilterMask() const noexcept { return filterMask; }
+
+		void setFilterMask(PxU32 newMask) noexcept;
+
+		NODISCARD PxFilterData getSimulationFilterData() const noexcept { return PxFilterData(layerToMask(layer), filterMask, 0, 0); }
+
+		NODISCARD PxFilterData getQueryFilterData() const noexcept { return PxFilterData(layerToMask(layer), 0, 0, 0); }
+
 		void setMass(float newMass) noexcept;
 
 		void onCollisionExit(rigidbody* collision) const noexcept;
@@ -85,8 +107,8 @@ namespace openps
 		float dynamicFriction = 0.8f;
 		float staticFriction = 0.8f;
 
-		PxU32 filterGroup = -1;
-		PxU32 filterMask = -1;
+		uint8_t layer = 0;
+		PxU32 filterMask = PX_LAYER_MASK_ALL;
 
 		PxRigidDynamicLockFlags rotLockNative;
 		PxRigidDynamicLockFlags posLockNative;
@@ -100,7 +122,9 @@ namespace openps
 		PxRigidActor* actor = nullptr;
 
 	private:
-		friend PxRigidActor* createRigidbodyActor(rigidbody* rb, collider_base* collider, const PxTransform& trs) noexcept;
+		void updateFilterData() noexcept;
+
+		friend PxRigidActor* createRigidbodyActor(rigidbody* rb, collider_base* collider, const PxTransform& trs, bool addToScene) noexcept;
 	};
 }
 
@@ -0,0 +1,45 @@
+#ifndef _OPENPS_RIGIDBODY_POOL_
+#define _OPENPS_RIGIDBODY_POOL_
+
+#include <openps_decl.h>
+#include <ecs/px_rigidbody.h>
+#include <ecs/px_colliders.h>
+
+namespace openps
+{
+	using namespace physx;
+
+	// Pre-creates dynamic actors of one collider archetype. Free actors are parked outside the scene, so they cost
+	// nothing in the broadphase, scene queries or exportBounds. acquire and release only add and remove the actor.
+	struct rigidbody_pool
+	{
+		rigidbody_pool(const rigidbody& prototype, collider_base* collider, uint32_t capacity,
+			const PxTransform& parkingPose = PxTransform(PxVec3(0.0f, -10000.0f, 0.0f))) noexcept;
+
+		rigidbody_pool(const rigidbody_pool&) = delete;
+		rigidbody_pool& operator=(const rigidbody_pool&) = delete;
+
+		~rigidbody_pool();
+
+		NODISCARD rigidbody* acquire(uint32_t handle, const PxTransform& pose,
+			const PxVec3& linearVelocity = PxVec3(0.0f), const PxVec3& angularVelocity = PxVec3(0.0f)) noexcept;
+
+		void release(rigidbody* rb) noexcept;
+
+		NODISCARD uint32_t getCapacity() const noexcept { return (uint32_t)bodies.size(); }
+
+		NODISCARD uint32_t getNbFree() const noexcept { return (uint32_t)freeIndices.size(); }
+
+		NODISCARD bool owns(const rigidbody* rb) const noexcept { return rb >= bodies.data() && rb < bodies.data() + bodies.size(); }
+
+	private:
+		std::vector<rigidbody> bodies;
+		std::vector<uint32_t> freeIndices;
+
+		PxTransform parkingPose;
+
+		std::mutex mutex;
+	};
+}
+
+#endif
\ No newline at end of file
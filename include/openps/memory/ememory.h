@@ -44,32 +44,110 @@ namespace openps
 		uint64_t before;
 	};
 
+	enum class page_mode : uint8_t
+	{
+		Default,
+
+		// Linux only, asks the kernel to back the reservation with transparent huge pages
+		TransparentHuge,
+
+		// Linux only, reserves from the hugetlbfs pool and falls back to Default when it can't hold the whole reservation
+		ExplicitHuge
+	};
+
+	struct eallocator;
+
+	// Called with the allocator's mutex held when committing requestedCommit bytes would exceed the budget.
+	// Returning true commits anyway, returning false fails the allocation with nullptr.
+	using memory_budget_func_ptr = bool(*)(const eallocator& allocator, uint64_t requestedCommit, uint64_t budget, void* userData);
+
+	// Decommit policy applied by reset(false), which is treated as the frame boundary
+	struct memory_trim_policy
+	{
+		// Frames whose high-water marks are remembered, 0 disables trimming
+		uint32_t windowFrames = 0;
+
+		// Headroom kept committed above the window's high-water mark, as a fraction of it
+		float slack = 0.25f;
+
+		// Never trims below this
+		uint64_t minimumCommit = 0;
+	};
+
+	struct memory_stats
+	{
+		uint64_t reserved = 0;
+		uint64_t committed = 0;
+		uint64_t used = 0;
+
+		// Highest used size since initialize and within the trim window
+		uint64_t highWater = 0;
+		uint64_t windowHighWater = 0;
+
+		// 0 when unlimited
+		uint64_t budget = 0;
+
+		// Commits past the budget, whether the callback let them through or not
+		uint64_t overflows = 0;
+
+		uint64_t trims = 0;
+		uint64_t decommittedBytes = 0;
+	};
+
+	// Bump allocator over one virtual reservation. Offsets are claimed with a CAS on current, only committing new
+	// pages takes the mutex. allocateLocal additionally carves per-thread chunks so small allocations don't
+	// contend on current at all. reset, resetToMarker, setCurrentTo and decommit must not run concurrently with allocations.
 	struct eallocator
 	{
 	protected:
-		uint64_t committedMemory = 0;
+		std::atomic<uint64_t> committedMemory = 0;
 
-		uint64_t current = 0;
-		uint64_t sizeLeftCurrent = 0;
+		std::atomic<uint64_t> current = 0;
 
-		uint64_t sizeLeftTotal = 0;
+		// Bumped on every reset, thread chunks of an older epoch are dropped on their next use
+		std::atomic<uint64_t> epoch = 0;
 
 		uint64_t pageSize = 0;
 		uint64_t minimumBlockSize = 0;
 
 		uint64_t reserveSize = 0;
 
+		uint64_t threadChunkSize = KB(64);
+
+		// Unique per instance, a new allocator at the address of a destroyed one mustn't reuse its thread chunks
+		uint64_t id = 0;
+
+		page_mode pages = page_mode::Default;
+
+		uint64_t budget = 0;
+		memory_budget_func_ptr budgetFunc = nullptr;
+		void* budgetUserData = nullptr;
+
+		memory_trim_policy trimPolicy;
+
+		// current only shrinks in the non-concurrent reset functions, so sampling it there catches every peak
+		uint64_t frameHighWater = 0;
+		uint64_t highWater = 0;
+
+		// Ring buffer of the last trimPolicy.windowFrames frame peaks
+		std::vector<uint64_t> windowHighWaters;
+		uint32_t windowIndex = 0;
+
+		std::atomic<uint64_t> overflows = 0;
+		uint64_t trims = 0;
+		uint64_t decommittedBytes = 0;
+
 		std::mutex mutex;
 
 		uint8_t* memory = 0;
 
 	public:
-		eallocator() noexcept {}
+		eallocator() noexcept;
 		eallocator(const eallocator&) = delete;
-		eallocator(eallocator&&) = default;
+		eallocator(eallocator&&) = delete;
 		~eallocator() { reset(true); }
 
-		void initialize(uint64_t minimumBlockSize = 0, uint64_t reserveSize = GB(8)) noexcept;
+		void initialize(uint64_t minimumBlockSize = 0, uint64_t reserveSize = GB(8), page_mode pages = page_mode::Default) noexcept;
 
 		void ensureFreeSize(uint64_t size) noexcept;
 
@@ -81,9 +159,28 @@ namespace openps
 			return (T*)allocate(sizeof(T) * count, alignof(T), clearToZero);
 		}
 
+		// Allocates from the calling thread's chunk. Allocations larger than a quarter chunk go to allocate.
+		NODISCARD void* allocateLocal(uint64_t size, uint64_t alignment = 4, bool clearToZero = false) noexcept;
+
+		template <typename T>
+		NODISCARD T* allocateLocal(uint32_t count = 1, bool clearToZero = false) noexcept
+		{
+			return (T*)allocateLocal(sizeof(T) * count, alignof(T), clearToZero);
+		}
+
+		void setThreadChunkSize(uint64_t size) noexcept { threadChunkSize = size; }
+
+		// Limits committed memory to budget bytes, 0 removes the limit. Without a callback overflowing commits are
+		// only counted in the stats.
+		void setBudget(uint64_t budget, memory_budget_func_ptr func = nullptr, void* userData = nullptr) noexcept;
+
+		void setTrimPolicy(const memory_trim_policy& policy) noexcept;
+
+		NODISCARD memory_stats getStats() const noexcept;
+
 		NODISCARD void* getCurrent(uint64_t alignment = 4) const noexcept
 		{
-			return memory + alignTo(current, alignment);
+			return memory + alignTo(current.load(std::memory_order_relaxed), alignment);
 		}
 
 		template <typename T>
@@ -98,12 +195,40 @@ namespace openps
 
 		void resetToMarker(memory_marker marker) noexcept;
 
-		NODISCARD const memory_marker getMarker() const noexcept { return { current }; }
+		// Returns committed pages past the current offset (and past keepSize) to the OS, the range stays reserved
+		void decommit(uint64_t keepSize = 0) noexcept;
+
+		NODISCARD uint64_t getCommittedSize() const noexcept { return committedMemory.load(std::memory_order_relaxed); }
+
+		NODISCARD uint64_t getUsedSize() const noexcept { return current.load(std::memory_order_relaxed); }
+
+		NODISCARD uint64_t getPageSize() const noexcept { return pageSize; }
+
+		NODISCARD page_mode getPageMode() const noexcept { return pages; }
+
+		NODISCARD const memory_marker getMarker() const noexcept { return { current.load(std::memory_order_relaxed) }; }
 
 		NODISCARD uint8_t* base() const noexcept { return memory; }
 
+		NODISCARD bool owns(const void* ptr) const noexcept { return ptr >= memory && ptr < memory + reserveSize; }
+
 	protected:
-		void ensureFreeSizeInternal(uint64_t size) noexcept;
+		static constexpr uint64_t invalidOffset = 0xFFFFFFFFFFFFFFFF;
+
+		// Returns the offset of size bytes, committing pages under the mutex when the range isn't backed yet.
+		// invalidOffset when the range runs past the reservation or the budget callback refused the commit.
+		NODISCARD uint64_t claim(uint64_t size, uint64_t alignment) noexcept;
+
+		NODISCARD bool commitTo(uint64_t end) noexcept;
+
+		NODISCARD bool commitToInternal(uint64_t end) noexcept;
+
+		void decommitInternal(uint64_t keepSize) noexcept;
+
+		// Records the peak of the frame that just ended and decommits above the window's high-water mark
+		void trim() noexcept;
+
+		void sampleHighWater() noexcept { frameHighWater = max(frameHighWater, current.load(std::memory_order_relaxed)); }
 	};
 }
 
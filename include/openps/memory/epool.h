@@ -0,0 +1,133 @@
+#ifndef _OPENPS_EPOOL_
+#define _OPENPS_EPOOL_
+
+#include <openps_decl.h>
+
+namespace openps
+{
+	struct allocation_type_stats
+	{
+		const char* typeName = nullptr;
+
+		uint64_t liveBytes = 0;
+		uint64_t peakBytes = 0;
+
+		uint64_t liveAllocations = 0;
+		uint64_t totalAllocations = 0;
+	};
+
+	// General purpose allocator for many small, same sized blocks. Blocks up to maxSmallSize are served from
+	// per-thread free lists per size class, which refill from and spill to shared lists in batches. Larger blocks
+	// go straight to alignedAlloc. Every block has a 16 byte header, so results stay 16 byte aligned.
+	struct epool_allocator
+	{
+		static constexpr uint32_t headerSize = 16;
+		static constexpr uint32_t maxSmallSize = 2048;
+		static constexpr uint32_t nbSizeClasses = 14;
+
+		epool_allocator() noexcept;
+		epool_allocator(const epool_allocator&) = delete;
+		epool_allocator(epool_allocator&&) = delete;
+		~epool_allocator();
+
+		// typeName is only recorded while type tracking is enabled and has to outlive the allocator
+		NODISCARD void* allocate(size_t size, const char* typeName = nullptr) noexcept;
+
+		void deallocate(void* ptr) noexcept;
+
+		// Costs a mutex per allocation. Blocks allocated while it was off aren't attributed to any type.
+		// PhysX only passes real type names once PxFoundation::setReportAllocationNames(true) was called.
+		void setTrackTypes(bool track) noexcept { trackTypes.store(track, std::memory_order_relaxed); }
+
+		NODISCARD bool getTrackTypes() const noexcept { return trackTypes.load(std::memory_order_relaxed); }
+
+		// Types with equal names are merged with their peaks summed, sorted by live bytes
+		void getTypeStats(std::vector<allocation_type_stats>& result) const noexcept;
+
+		// Requested bytes of all live blocks, without headers and size class rounding
+		NODISCARD uint64_t getLiveBytes() const noexcept { return liveBytes.load(std::memory_order_relaxed); }
+
+		// Bytes held in slabs for the small size classes
+		NODISCARD uint64_t getPooledBytes() const noexcept { return pooledBytes.load(std::memory_order_relaxed); }
+
+	private:
+		struct free_block
+		{
+			free_block* next;
+		};
+
+		struct block_header
+		{
+			uint64_t size;
+			uint32_t sizeClass;
+			uint32_t typeIndex;
+		};
+
+		struct free_list
+		{
+			free_block* head = nullptr;
+			uint32_t count = 0;
+		};
+
+		struct thread_cache
+		{
+			std::thread::id owner;
+			free_list lists[nbSizeClasses];
+		};
+
+		struct central_list
+		{
+			std::mutex mutex;
+			free_list list;
+		};
+
+		struct type_entry
+		{
+			const char* typeName = nullptr;
+
+			std::atomic<uint64_t> liveBytes = 0;
+			std::atomic<uint64_t> peakBytes = 0;
+			std::atomic<uint64_t> liveAllocations = 0;
+			std::atomic<uint64_t> totalAllocations = 0;
+		};
+
+		NODISCARD static uint32_t sizeClassOf(uint64_t blockSize) noexcept;
+
+		NODISCARD thread_cache* getThreadCache() noexcept;
+
+		void refill(uint32_t sizeClass, free_list& list) noexcept;
+
+		void spill(uint32_t sizeClass, free_list& list) noexcept;
+
+		NODISCARD uint32_t getTypeIndex(const char* typeName) noexcept;
+
+	private:
+		static constexpr uint32_t noType = 0xFFFFFFFF;
+		static constexpr uint32_t largeClass = 0xFFFFFFFF;
+
+		uint64_t id = 0;
+
+		central_list central[nbSizeClasses];
+
+		std::mutex cacheMutex;
+		std::vector<thread_cache*> caches;
+
+		std::mutex slabMutex;
+		std::vector<void*> slabs;
+
+		// Fixed size so deallocate can index it without the mutex, types past the end aren't tracked
+		static constexpr uint32_t maxTypes = 512;
+
+		std::mutex typeMutex;
+		std::unordered_map<const char*, uint32_t> typeIndices;
+		type_entry types[maxTypes];
+		std::atomic<uint32_t> nbTypes = 0;
+
+		std::atomic<uint64_t> liveBytes = 0;
+		std::atomic<uint64_t> pooledBytes = 0;
+
+		std::atomic<bool> trackTypes = false;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef _OPENPS_ERESOURCE_
+#define _OPENPS_ERESOURCE_
+
+#include <memory_resource>
+
+#include <memory/ememory.h>
+
+namespace openps
+{
+	// std::pmr adapter over an eallocator. Deallocation is a no-op, memory comes back when the arena is reset, so
+	// containers using it must be destroyed or rebuilt before that. Allocations the arena refuses, because the budget
+	// callback said no or the reservation is full, go to upstream instead and are freed there.
+	struct eallocator_resource : std::pmr::memory_resource
+	{
+		eallocator_resource(eallocator* arena, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) noexcept
+			: arena(arena), upstream(upstream) {}
+
+		NODISCARD eallocator* getArena() const noexcept { return arena; }
+
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+
+		void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	private:
+		eallocator* arena = nullptr;
+		std::pmr::memory_resource* upstream = nullptr;
+	};
+
+	// Rolls the arena back to where it was at construction
+	struct memory_scope
+	{
+		memory_scope(eallocator& arena) noexcept : arena(arena), marker(arena.getMarker()) {}
+		memory_scope(const memory_scope&) = delete;
+		memory_scope& operator=(const memory_scope&) = delete;
+
+		~memory_scope() { arena.resetToMarker(marker); }
+
+	private:
+		eallocator& arena;
+		memory_marker marker;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -10,8 +10,21 @@
 #include <core/px_aggregates.h>
 #include <core/px_tasks.h>
 #include <core/px_gjk_support.h>
+#include <core/px_materials.h>
+#include <core/px_shapes.h>
+#include <core/px_layers.h>
+#include <core/px_static_world.h>
+#include <core/px_scene_query.h>
+#include <core/px_line_of_sight.h>
+#include <core/px_trigger_volumes.h>
+#include <core/px_bounds.h>
 
 #include <ecs/px_rigidbody.h>
 #include <ecs/px_colliders.h>
+#include <ecs/px_rigidbody_pool.h>
+
+#include <memory/ememory.h>
+#include <memory/epool.h>
+#include <memory/eresource.h>
 
 #endif
\ No newline at end of file
@@ -1,14 +1,19 @@
 #ifndef _OPENPS_DECLS_
 #define _OPENPS_DECLS_
 
+#if defined(_WIN32)
 #include <intrin.h>
-#include <xmmintrin.h>
 #include <Windows.h>
+#include <tchar.h>
+#else
+#include <x86intrin.h>
+#endif
+#include <xmmintrin.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <ctype.h>
 #include <math.h>
-#include <tchar.h>
 #include <mutex>
 #include <limits>
 #include <array>
@@ -21,7 +26,10 @@
 #include <queue>
 #include <functional>
 #include <tuple>
-#include <intrin.h>
+#include <span>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 #include <stddef.h>
 
 #include <cuda.h>
@@ -38,6 +46,14 @@
 
 #define PX_ENABLE_RAYCAST_CCD 0
 
+#define PX_MATERIAL_QUANTIZATION_STEP 0.001f
+
+#define PX_NB_COLLISION_LAYERS 32
+#define PX_LAYER_MASK_ALL 0xFFFFFFFF
+
+#define PX_MAX_PARALLEL_RANGES 64
+#define PX_QUERY_BATCH_GRAIN_SIZE 64
+
 #define NODISCARD [[nodiscard]]
 
 #if _DEBUG
@@ -48,11 +64,17 @@
 
 #define UNUSED(x) (void)(x)
 
+#if defined(_WIN32)
+#define DEBUG_BREAK() ::__debugbreak()
+#else
+#define DEBUG_BREAK() __builtin_trap()
+#endif
+
 #define RELEASE_PTR(ptr) if(ptr) { delete ptr; ptr = nullptr; }
 #define RELEASE_ARRAY_PTR(arrayPtr) if(arrayPtr) { delete[] arrayPtr; arrayPtr = nullptr; } 
 
 #define ASSERT(cond) \
-	(void)((!!(cond)) || (std::cout << "Assertion '" << #cond "' failed [" __FILE__ " : " << __LINE__ << "].\n", ::__debugbreak(), 0))
+	(void)((!!(cond)) || (std::cout << "Assertion '" << #cond "' failed [" __FILE__ " : " << __LINE__ << "].\n", DEBUG_BREAK(), 0))
 
 static inline physx::PxVec3 gravity(0.0f, -9.8f, 0.0f);
 
@@ -95,7 +117,9 @@ NODISCARD constexpr inline auto max(T a, T b) noexcept
 	return (a < b) ? b : a;
 }
 
+#ifndef M_PI
 #define M_PI 3.14159265359f
+#endif
 #define M_PI_OVER_2 (M_PI * 0.5f)
 #define M_PI_OVER_180 (M_PI / 180.f)
 #define M_180_OVER_PI (180.f / M_PI)
@@ -127,7 +151,10 @@ inline constexpr auto BYTE_TO_MB(T b) noexcept { return ((b) / (1024 * 1024)); }
 template<typename T>
 inline constexpr auto BYTE_TO_GB(T b) noexcept { return ((b) / (1024 * 1024)); }
 
+// libstdc++ already exports std::lerp into the global namespace from <math.h> in C++20
+#if !defined(__GLIBCXX__) || __cplusplus < 202002L
 NODISCARD inline constexpr float lerp(float l, float u, float t) noexcept { return l + t * (u - l); }
+#endif
 NODISCARD inline constexpr float inverseLerp(float l, float u, float v) noexcept { return (v - l) / (u - l); }
 NODISCARD inline constexpr float remap(float v, float oldL, float oldU, float newL, float newU) noexcept { return lerp(newL, newU, inverseLerp(oldL, oldU, v)); }
 NODISCARD inline constexpr float clamp(float v, float l, float u) noexcept { float r = max(l, v); r = min(u, r); return r; }
@@ -138,37 +165,53 @@ NODISCARD inline constexpr float saturate(float v) noexcept { return clamp01(v);
 NODISCARD inline constexpr float smoothstep(float t) noexcept { return t * t * (3.f - 2.f * t); }
 NODISCARD inline constexpr float smoothstep(float l, float u, float v) noexcept { return smoothstep(clamp01(inverseLerp(l, u, v))); }
 NODISCARD inline constexpr uint32_t bucketize(uint32_t problemSize, uint32_t bucketSize) noexcept { return (problemSize + bucketSize - 1) / bucketSize; }
-NODISCARD inline constexpr uint64_t bucketize(uint64_t problemSize, uint64_t bucketSize) noexcept { return (problemSize + bucketSize - 1) / bucketSize; }\
+NODISCARD inline constexpr uint64_t bucketize(uint64_t problemSize, uint64_t bucketSize) noexcept { return (problemSize + bucketSize - 1) / bucketSize; }
+
+NODISCARD inline void* alignedAlloc(size_t size, size_t alignment) noexcept
+{
+#if defined(_WIN32)
+	return _aligned_malloc(size, alignment);
+#else
+	// aligned_alloc wants a multiple of the alignment
+	return aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+}
 
-#define PX_SCENE_QUERY_SETUP(blockSingle) \
-const PxHitFlags hitFlags = PxHitFlag::ePOSITION | PxHitFlag::eNORMAL | PxHitFlag::eMESH_MULTIPLE | PxHitFlag::eUV; \
+inline void alignedFree(void* ptr) noexcept
+{
+#if defined(_WIN32)
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+// Overlaps take no hit flags, they only need the filter data
+#define PX_SCENE_QUERY_FILTER_SETUP_MASK(blockSingle, mask) \
 PxQueryFilterData filterData; \
-filterData.flags |= PxQueryFlag::eDYNAMIC | PxQueryFlag::eSTATIC; \
-filterData.data.word0 = layerMask; \
+filterData.flags |= PxQueryFlag::eDYNAMIC | PxQueryFlag::eSTATIC | PxQueryFlag::ePREFILTER; \
+filterData.data.word0 = mask; \
 filterData.data.word1 = blockSingle ? 1 : 0; \
 filterData.data.word2 = hitTriggers ? 1 : 0
 
-#define PX_SCENE_QUERY_SETUP_SWEEP_CAST_ALL() PX_SCENE_QUERY_SETUP(true); \
-		PxSweepBufferN<1> buffer
+#define PX_SCENE_QUERY_FILTER_SETUP(blockSingle) PX_SCENE_QUERY_FILTER_SETUP_MASK(blockSingle, layerMask)
+
+// Batches pass the mask per query and overwrite word0 for every entry
+#define PX_SCENE_QUERY_SETUP_MASK(blockSingle, mask) \
+const PxHitFlags hitFlags = PxHitFlag::ePOSITION | PxHitFlag::eNORMAL | PxHitFlag::eMESH_MULTIPLE | PxHitFlag::eUV | PxHitFlag::eFACE_INDEX; \
+PX_SCENE_QUERY_FILTER_SETUP_MASK(blockSingle, mask)
 
-#define PX_SCENE_QUERY_SETUP_SWEEP_CAST() PX_SCENE_QUERY_SETUP(false); \
-		DynamicHitBuffer<PxSweepHit> buffer
+#define PX_SCENE_QUERY_SETUP(blockSingle) PX_SCENE_QUERY_SETUP_MASK(blockSingle, layerMask)
 
-#define PX_SCENE_QUERY_SETUP_CHECK() PX_SCENE_QUERY_SETUP(false); \
-		PxOverlapBufferN<1> buffer
+#define PX_SCENE_QUERY_SETUP_SWEEP_CAST_ALL() PX_SCENE_QUERY_SETUP(false); \
+		closest_hits_collector<PxSweepHit, sweep_hit> buffer(*this, hits)
 
-#define PX_SCENE_QUERY_SETUP_OVERLAP() PX_SCENE_QUERY_SETUP(false); \
-		DynamicHitBuffer<PxOverlapHit> buffer
+#define PX_SCENE_QUERY_SETUP_SWEEP_CAST() PX_SCENE_QUERY_SETUP(true); \
+		PxSweepBuffer buffer
 
-#define PX_SCENE_QUERY_COLLECT_OVERLAP() results.clear(); \
-		results.resize(buffer.getNbTouches()); \
-		size_t resultSize = results.size(); \
-		for (uint32_t i = 0; i < resultSize; ++i) \
-		{ \
-			auto& hitInfo = results[i]; \
-			const auto& hit = buffer.getTouch(i); \
-			hitInfo = hit.shape ? static_cast<uint32_t*>(hit.shape->userData) : nullptr; \
-		}
+#define PX_SCENE_QUERY_SETUP_CHECK() PX_SCENE_QUERY_FILTER_SETUP(false); \
+		filterData.flags |= PxQueryFlag::eANY_HIT; \
+		PxOverlapBuffer buffer
 
 namespace physx
 {
@@ -1,8 +1,9 @@
 #include <core/px_aggregates.h>
 
-openps::px_aggregate::px_aggregate(uint8_t nb, bool sc) noexcept : nbActors(nb), selfCollisions(sc)
+openps::px_aggregate::px_aggregate(uint32_t nb, bool sc, physx::PxAggregateType::Enum aggregateType, uint32_t nbShapes) noexcept : nbActors(nb), selfCollisions(sc)
 {
-	aggregate = openps::physics_holder::physicsRef->getPhysicsImpl()->createAggregate(nbActors, selfCollisions, physx::PxAggregateFilterHint());
+	const physx::PxAggregateFilterHint filterHint = physx::PxGetAggregateFilterHint(aggregateType, selfCollisions);
+	aggregate = openps::physics_holder::physicsRef->getPhysicsImpl()->createAggregate(nbActors, nbShapes ? nbShapes : nbActors, filterHint);
 	openps::physics_holder::physicsRef->addAggregate(aggregate);
 }
 
@@ -20,4 +21,235 @@ void openps::px_aggregate::addActor(physx::PxActor* actor) noexcept
 void openps::px_aggregate::removeActor(physx::PxActor* actor) noexcept
 {
 	aggregate->removeActor(*actor);
+	openps::physics_holder::physicsRef->invalidateQueryCaches();
+}
+
+void openps::aggregate_builder::addActor(physx::PxRigidActor* actor) noexcept
+{
+	if (actor && !trackedActors.contains(actor))
+		pendingActors.push_back(actor);
+}
+
+void openps::aggregate_builder::removeActor(physx::PxRigidActor* actor) noexcept
+{
+	auto pending = std::find(pendingActors.begin(), pendingActors.end(), actor);
+	if (pending != pendingActors.end())
+		pendingActors.erase(pending);
+
+	auto iter = trackedActors.find(actor);
+	if (iter == trackedActors.end())
+		return;
+
+	physics_lock_write lock{};
+
+	const tracked_actor tracked = iter->second;
+	trackedActors.erase(iter);
+	eraseActor(actor, tracked);
+
+	openps::physics_holder::physicsRef->addActor(actor);
+}
+
+void openps::aggregate_builder::build() noexcept
+{
+	if (pendingActors.empty())
+		return;
+
+	physics_lock_write lock{};
+
+	for (physx::PxRigidActor* actor : pendingActors)
+	{
+		if (actor->getAggregate())
+		{
+			logger::log_error("Physics> Actor already belongs to an aggregate.");
+			continue;
+		}
+
+		if (actor->getScene())
+			openps::physics_holder::physicsRef->reomoveActor(actor);
+
+		insertActor(actor);
+	}
+
+	pendingActors.clear();
+}
+
+void openps::aggregate_builder::rebalance() noexcept
+{
+	const float rebalanceDistanceSq = desc.rebalanceDistance * desc.rebalanceDistance;
+
+	std::vector<physx::PxRigidActor*> movedActors;
+
+	{
+		physics_lock_read lock{};
+
+		for (auto& [actor, tracked] : trackedActors)
+		{
+			if (actor->is<physx::PxRigidStatic>())
+				continue;
+
+			const physx::PxVec3 position = actor->getWorldBounds().getCenter();
+
+			if ((position - tracked.anchor).magnitudeSquared() <= rebalanceDistanceSq)
+				continue;
+
+			if (getCellKey(actor, position) == tracked.cell)
+				tracked.anchor = position;
+			else
+				movedActors.push_back(actor);
+		}
+	}
+
+	if (movedActors.empty())
+		return;
+
+	physics_lock_write lock{};
+
+	for (physx::PxRigidActor* actor : movedActors)
+	{
+		auto iter = trackedActors.find(actor);
+		const tracked_actor tracked = iter->second;
+		trackedActors.erase(iter);
+
+		eraseActor(actor, tracked);
+		insertActor(actor);
+	}
+}
+
+void openps::aggregate_builder::release() noexcept
+{
+	pendingActors.clear();
+
+	if (trackedActors.empty() || !openps::physics_holder::physicsRef)
+		return;
+
+	physics_lock_write lock{};
+
+	while (!trackedActors.empty())
+	{
+		auto iter = trackedActors.begin();
+		physx::PxRigidActor* actor = iter->first;
+		const tracked_actor tracked = iter->second;
+		trackedActors.erase(iter);
+
+		eraseActor(actor, tracked);
+		openps::physics_holder::physicsRef->addActor(actor);
+	}
+}
+
+NODISCARD uint64_t openps::aggregate_builder::getCellKey(physx::PxRigidActor* actor, const physx::PxVec3& position) const noexcept
+{
+	uint64_t kind = 0;
+
+	if (actor->is<physx::PxRigidStatic>())
+		kind = 1;
+	else if (auto body = actor->is<physx::PxRigidBody>(); body && body->getRigidBodyFlags() & physx::PxRigidBodyFlag::eKINEMATIC)
+		kind = 2;
+
+	const float invCellSize = 1.0f / desc.cellSize;
+
+	// 20 bits per axis, cell coordinates are offset to be positive
+	const uint64_t x = (uint64_t)((int64_t)floorf(position.x * invCellSize) + (1 << 19)) & 0xFFFFF;
+	const uint64_t y = (uint64_t)((int64_t)floorf(position.y * invCellSize) + (1 << 19)) & 0xFFFFF;
+	const uint64_t z = (uint64_t)((int64_t)floorf(position.z * invCellSize) + (1 << 19)) & 0xFFFFF;
+
+	return x | (y << 20) | (z << 40) | (kind << 60);
+}
+
+void openps::aggregate_builder::insertActor(physx::PxRigidActor* actor) noexcept
+{
+	const physx::PxVec3 position = actor->getWorldBounds().getCenter();
+	const uint64_t cell = getCellKey(actor, position);
+
+	auto& aggregates = cells[cell];
+
+	physx::PxAggregate* aggregate = nullptr;
+
+	for (physx::PxAggregate* candidate : aggregates)
+	{
+		if (candidate->getNbActors() < candidate->getMaxNbActors() && aggregateShapes[candidate] + actor->getNbShapes() <= candidate->getMaxNbShapes())
+		{
+			aggregate = candidate;
+			break;
+		}
+	}
+
+	if (!aggregate)
+	{
+		physx::PxAggregateFilterHint filterHint{};
+
+		switch (cell >> 60)
+		{
+		case 1:
+			filterHint = physx::PxGetAggregateFilterHint(physx::PxAggregateType::eSTATIC, false);
+			break;
+		case 2:
+			filterHint = physx::PxGetAggregateFilterHint(physx::PxAggregateType::eKINEMATIC, false);
+			break;
+		default:
+			filterHint = physx::PxGetAggregateFilterHint(physx::PxAggregateType::eGENERIC, desc.dynamicSelfCollisions);
+			break;
+		}
+
+		const uint32_t maxShapes = desc.maxShapesPerAggregate ? desc.maxShapesPerAggregate : desc.maxActorsPerAggregate * 4U;
+
+		aggregate = openps::physics_holder::physicsRef->getPhysicsImpl()->createAggregate(desc.maxActorsPerAggregate, maxShapes, filterHint);
+
+		if (!aggregate)
+		{
+			logger::log_error("Physics> Failed to create PxAggregate.");
+			openps::physics_holder::physicsRef->addActor(actor);
+			return;
+		}
+
+		openps::physics_holder::physicsRef->addAggregate(aggregate);
+		aggregates.push_back(aggregate);
+		++nbAggregates;
+	}
+
+	// A compound actor can have more shapes than a fresh aggregate takes
+	if (!aggregate->addActor(*actor))
+	{
+		logger::log_error("Physics> Actor doesn't fit into a PxAggregate.");
+		openps::physics_holder::physicsRef->addActor(actor);
+
+		if (aggregate->getNbActors() == 0)
+		{
+			aggregates.pop_back();
+			if (aggregates.empty())
+				cells.erase(cell);
+
+			aggregateShapes.erase(aggregate);
+			openps::physics_holder::physicsRef->removeAggregate(aggregate);
+			aggregate->release();
+			--nbAggregates;
+		}
+
+		return;
+	}
+
+	aggregateShapes[aggregate] += actor->getNbShapes();
+	trackedActors.emplace(actor, tracked_actor{ aggregate, position, cell });
+}
+
+void openps::aggregate_builder::eraseActor(physx::PxRigidActor* actor, const tracked_actor& tracked) noexcept
+{
+	tracked.aggregate->removeActor(*actor);
+	openps::physics_holder::physicsRef->invalidateQueryCaches();
+
+	aggregateShapes[tracked.aggregate] -= actor->getNbShapes();
+
+	if (tracked.aggregate->getNbActors() != 0)
+		return;
+
+	aggregateShapes.erase(tracked.aggregate);
+
+	auto& aggregates = cells[tracked.cell];
+	aggregates.erase(std::find(aggregates.begin(), aggregates.end(), tracked.aggregate));
+
+	if (aggregates.empty())
+		cells.erase(tracked.cell);
+
+	openps::physics_holder::physicsRef->removeAggregate(tracked.aggregate);
+	tracked.aggregate->release();
+	--nbAggregates;
 }
\ No newline at end of file
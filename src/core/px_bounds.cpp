@@ -0,0 +1,98 @@
+#include <core/px_bounds.h>
+
+static inline uint32_t writeMask(int mask, uint32_t base, uint32_t* outIndices, uint32_t nbOut) noexcept
+{
+	while (mask)
+	{
+		outIndices[nbOut++] = base + physx::PxLowestSetBit((uint32_t)mask);
+		mask &= mask - 1;
+	}
+
+	return nbOut;
+}
+
+uint32_t openps::cullBounds(const bounds_soa& bounds, uint32_t count, const PxBounds3& region, uint32_t* outIndices) noexcept
+{
+	const __m128 regionMinX = _mm_set1_ps(region.minimum.x), regionMaxX = _mm_set1_ps(region.maximum.x);
+	const __m128 regionMinY = _mm_set1_ps(region.minimum.y), regionMaxY = _mm_set1_ps(region.maximum.y);
+	const __m128 regionMinZ = _mm_set1_ps(region.minimum.z), regionMaxZ = _mm_set1_ps(region.maximum.z);
+
+	uint32_t nbOut = 0;
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 overlap = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(bounds.minX + i), regionMaxX), _mm_cmple_ps(regionMinX, _mm_loadu_ps(bounds.maxX + i)));
+		overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(bounds.minY + i), regionMaxY), _mm_cmple_ps(regionMinY, _mm_loadu_ps(bounds.maxY + i))));
+		overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(bounds.minZ + i), regionMaxZ), _mm_cmple_ps(regionMinZ, _mm_loadu_ps(bounds.maxZ + i))));
+
+		nbOut = writeMask(_mm_movemask_ps(overlap), i, outIndices, nbOut);
+	}
+
+	for (; i < count; ++i)
+	{
+		if (bounds.minX[i] <= region.maximum.x && region.minimum.x <= bounds.maxX[i]
+			&& bounds.minY[i] <= region.maximum.y && region.minimum.y <= bounds.maxY[i]
+			&& bounds.minZ[i] <= region.maximum.z && region.minimum.z <= bounds.maxZ[i])
+			outIndices[nbOut++] = i;
+	}
+
+	return nbOut;
+}
+
+uint32_t openps::cullBounds(const bounds_soa& bounds, uint32_t count, std::span<const PxPlane> planes, uint32_t* outIndices) noexcept
+{
+	const __m128 zero = _mm_setzero_ps();
+
+	uint32_t nbOut = 0;
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 minX = _mm_loadu_ps(bounds.minX + i), maxX = _mm_loadu_ps(bounds.maxX + i);
+		const __m128 minY = _mm_loadu_ps(bounds.minY + i), maxY = _mm_loadu_ps(bounds.maxY + i);
+		const __m128 minZ = _mm_loadu_ps(bounds.minZ + i), maxZ = _mm_loadu_ps(bounds.maxZ + i);
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+
+		for (const PxPlane& plane : planes)
+		{
+			const __m128 nx = _mm_set1_ps(plane.n.x);
+			const __m128 ny = _mm_set1_ps(plane.n.y);
+			const __m128 nz = _mm_set1_ps(plane.n.z);
+
+			// Distance of the corner furthest along the normal
+			__m128 distance = _mm_max_ps(_mm_mul_ps(nx, minX), _mm_mul_ps(nx, maxX));
+			distance = _mm_add_ps(distance, _mm_max_ps(_mm_mul_ps(ny, minY), _mm_mul_ps(ny, maxY)));
+			distance = _mm_add_ps(distance, _mm_max_ps(_mm_mul_ps(nz, minZ), _mm_mul_ps(nz, maxZ)));
+			distance = _mm_add_ps(distance, _mm_set1_ps(plane.d));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+		}
+
+		nbOut = writeMask(_mm_movemask_ps(inside), i, outIndices, nbOut);
+	}
+
+	for (; i < count; ++i)
+	{
+		bool inside = true;
+
+		for (const PxPlane& plane : planes)
+		{
+			const float distance = PxMax(plane.n.x * bounds.minX[i], plane.n.x * bounds.maxX[i])
+				+ PxMax(plane.n.y * bounds.minY[i], plane.n.y * bounds.maxY[i])
+				+ PxMax(plane.n.z * bounds.minZ[i], plane.n.z * bounds.maxZ[i]) + plane.d;
+
+			if (distance < 0.0f)
+			{
+				inside = false;
+				break;
+			}
+		}
+
+		if (inside)
+			outIndices[nbOut++] = i;
+	}
+
+	return nbOut;
+}
\ No newline at end of file
@@ -1,28 +1,101 @@
 #include "core/px_gjk_support.h"
+#include "core/px_physics.h"
+#include "core/px_tasks.h"
 
-bool openps::px_gjk_query::overlapImpl(const PxGjkQuery::Support& a, const PxGjkQuery::Support& b, const PxTransform& poseA, const PxTransform& poseB) noexcept
+#include <geomutils/PxContactBuffer.h>
+
+static physx::PxCpuDispatcher* getBatchDispatcher(physx::PxCpuDispatcher* dispatcher) noexcept
+{
+    if (dispatcher || !openps::physics_holder::physicsRef)
+        return dispatcher;
+
+    return openps::physics_holder::physicsRef->getDispatcher();
+}
+
+bool openps::px_gjk_query::overlap(const px_gjk_support& a, const px_gjk_support& b, const PxTransform& poseA, const PxTransform& poseB) noexcept
 {
     return PxGjkQuery::overlap(a, b, poseA, poseB);
 }
 
-bool openps::px_gjk_query::sweepImpl(const PxGjkQuery::Support& a, const PxGjkQuery::Support& b, const PxTransform& poseA, const PxTransform& poseB, const PxVec3& unitDir, PxReal maxDist, PxReal& hitDist, PxVec3& n, PxVec3& p) noexcept
+bool openps::px_gjk_query::raycast(const px_gjk_support& shape, const PxTransform& pose, const PxVec3& rayStart, const PxVec3& unitDir, float maxDist, gjk_sweep_hit& hit) noexcept
 {
-    return PxGjkQuery::sweep(a, b, poseA, poseB, unitDir, maxDist, hitDist, n, p);
+    return PxGjkQuery::raycast(shape, pose, rayStart, unitDir, maxDist, hit.distance, hit.normal, hit.position);
 }
 
-bool openps::px_gjk_query::raycastImpl(const PxGjkQuery::Support& shape, const PxTransform& pose, const PxVec3& rayStart, const PxVec3& unitDir, PxReal maxDist, PxReal& hitDist, PxVec3& n, PxVec3& p) noexcept
+bool openps::px_gjk_query::sweep(const px_gjk_support& a, const px_gjk_support& b, const PxTransform& poseA, const PxTransform& poseB, const PxVec3& unitDir, float maxDist, gjk_sweep_hit& hit) noexcept
 {
-    return PxGjkQuery::raycast(shape, pose, rayStart, unitDir, maxDist, hitDist, n, p);
+    return PxGjkQuery::sweep(a, b, poseA, poseB, unitDir, maxDist, hit.distance, hit.normal, hit.position);
 }
 
-bool openps::px_gjk_query::proximityInfoImpl(const PxGjkQuery::Support& a, const PxGjkQuery::Support& b, const PxTransform& poseA, const PxTransform& poseB, PxReal contactDistance, PxReal toleranceLength, PxVec3& pointA, PxVec3& pointB, PxVec3& separatingAxis, PxReal& separation) noexcept
+bool openps::px_gjk_query::proximityInfo(const px_gjk_support& a, const px_gjk_support& b, const PxTransform& poseA, const PxTransform& poseB, float contactDistance, float toleranceLength, gjk_proximity& result) noexcept
 {
     return PxGjkQuery::proximityInfo(a, b, poseA, poseB, contactDistance, toleranceLength,
-        pointA, pointB, separatingAxis, separation);
+        result.pointA, result.pointB, result.separatingAxis, result.separation);
 }
 
-bool openps::px_gjk_query::generateContactsImpl(const PxGjkQuery::Support& a, const PxGjkQuery::Support& b, const PxTransform& poseA, const PxTransform& poseB, PxReal contactDistance, PxReal toleranceLength, PxContactBuffer& contactBuffer) noexcept
+bool openps::px_gjk_query::generateContacts(const px_gjk_support& a, const px_gjk_support& b, const PxTransform& poseA, const PxTransform& poseB, float contactDistance, float toleranceLength, PxContactBuffer& contactBuffer) noexcept
 {
     return PxGjkQueryExt::generateContacts(a, b, poseA, poseB,
         contactDistance, toleranceLength, contactBuffer);
+}
+
+void openps::px_gjk_query::overlapBatch(std::span<const gjk_pair> pairs, std::span<bool> results, PxCpuDispatcher* dispatcher) noexcept
+{
+    ASSERT(results.size() >= pairs.size());
+
+    parallelFor(getBatchDispatcher(dispatcher), (uint32_t)pairs.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+                results[i] = PxGjkQuery::overlap(*pairs[i].a, *pairs[i].b, pairs[i].poseA, pairs[i].poseB);
+        });
+}
+
+void openps::px_gjk_query::sweepBatch(std::span<const gjk_sweep_query> queries, std::span<gjk_sweep_hit> hits, std::span<bool> results, PxCpuDispatcher* dispatcher) noexcept
+{
+    ASSERT(hits.size() >= queries.size() && results.size() >= queries.size());
+
+    parallelFor(getBatchDispatcher(dispatcher), (uint32_t)queries.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const gjk_sweep_query& query = queries[i];
+                gjk_sweep_hit& hit = hits[i];
+
+                results[i] = PxGjkQuery::sweep(*query.pair.a, *query.pair.b, query.pair.poseA, query.pair.poseB,
+                    query.direction, query.maxDistance, hit.distance, hit.normal, hit.position);
+            }
+        });
+}
+
+void openps::px_gjk_query::proximityInfoBatch(std::span<const gjk_pair> pairs, float contactDistance, float toleranceLength, std::span<gjk_proximity> proximities, std::span<bool> results, PxCpuDispatcher* dispatcher) noexcept
+{
+    ASSERT(proximities.size() >= pairs.size() && results.size() >= pairs.size());
+
+    parallelFor(getBatchDispatcher(dispatcher), (uint32_t)pairs.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const gjk_pair& pair = pairs[i];
+                gjk_proximity& result = proximities[i];
+
+                results[i] = PxGjkQuery::proximityInfo(*pair.a, *pair.b, pair.poseA, pair.poseB, contactDistance, toleranceLength,
+                    result.pointA, result.pointB, result.separatingAxis, result.separation);
+            }
+        });
+}
+
+void openps::px_gjk_query::generateContactsBatch(std::span<const gjk_pair> pairs, float contactDistance, float toleranceLength, std::span<PxContactBuffer> contactBuffers, PxCpuDispatcher* dispatcher) noexcept
+{
+    ASSERT(contactBuffers.size() >= pairs.size());
+
+    parallelFor(getBatchDispatcher(dispatcher), (uint32_t)pairs.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const gjk_pair& pair = pairs[i];
+
+                contactBuffers[i].reset();
+                PxGjkQueryExt::generateContacts(*pair.a, *pair.b, pair.poseA, pair.poseB, contactDistance, toleranceLength, contactBuffers[i]);
+            }
+        });
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include <core/px_line_of_sight.h>
+#include <core/px_tasks.h>
+
+namespace openps
+{
+	// The endpoints' own shapes never block the line
+	struct line_of_sight_filter : query_filter
+	{
+		PxQueryHitType::Enum preFilter(const PxFilterData& filterData, const PxShape* shape, const PxRigidActor* actor, PxHitFlags& queryFlags) override
+		{
+			if (actor == otherActor)
+				return PxQueryHitType::eNONE;
+
+			return query_filter::preFilter(filterData, shape, actor, queryFlags);
+		}
+
+		const PxRigidActor* otherActor = nullptr;
+	};
+}
+
+uint32_t openps::line_of_sight::addPair(const PxRigidActor* observer, const PxRigidActor* target, const PxVec3& observerOffset, const PxVec3& targetOffset) noexcept
+{
+	uint32_t index;
+
+	if (!freeIndices.empty())
+	{
+		index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)pairs.size();
+		pairs.emplace_back();
+		visibility.resize(bucketize((uint32_t)pairs.size(), 64U), 0);
+	}
+
+	pair& p = pairs[index];
+	p = pair();
+	p.observer = observer;
+	p.target = target;
+	p.observerOffset = observerOffset;
+	p.targetOffset = targetOffset;
+
+	return index;
+}
+
+void openps::line_of_sight::removePair(uint32_t index) noexcept
+{
+	pairs[index] = pair();
+	pairs[index].dirty = false;
+	visibility[index >> 6] &= ~(1ull << (index & 63));
+	freeIndices.push_back(index);
+}
+
+void openps::line_of_sight::invalidate() noexcept
+{
+	for (pair& p : pairs)
+		p.dirty = p.observer != nullptr;
+}
+
+NODISCARD bool openps::line_of_sight::needsTest(pair& p, const PxVec3& from, const PxVec3& to, uint32_t epoch) const noexcept
+{
+	if (p.dirty || ++p.framesSinceTest >= desc.maxFramesBetweenTests)
+		return true;
+
+	const float thresholdSq = desc.moveThreshold * desc.moveThreshold;
+
+	if ((from - p.lastObserver).magnitudeSquared() > thresholdSq || (to - p.lastTarget).magnitudeSquared() > thresholdSq)
+		return true;
+
+	if (!p.blocker)
+		return false;
+
+	// The blocker may have been released
+	if (p.blockerEpoch != epoch)
+		return true;
+
+	const PxTransform pose = p.blocker->getGlobalPose();
+	return (pose.p - p.blockerPose.p).magnitudeSquared() > thresholdSq || PxAbs(pose.q.dot(p.blockerPose.q)) < 0.9999f;
+}
+
+void openps::line_of_sight::update() noexcept
+{
+	auto physics = physics_holder::physicsRef;
+	PxScene* scene = physics->getScene();
+
+	const uint32_t epoch = physics->getQueryCacheEpoch();
+	const uint32_t layerMask = desc.layerMask;
+	const bool hitTriggers = desc.hitTriggers;
+
+	std::atomic<uint32_t> tested{ 0 };
+
+	parallelFor(physics->getQueryDispatcher(), (uint32_t)pairs.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+		{
+			physics_lock_read lock{};
+
+			PX_SCENE_QUERY_SETUP(true);
+			filterData.flags |= PxQueryFlag::eANY_HIT;
+
+			line_of_sight_filter filter;
+			uint32_t rangeTested = 0;
+
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				pair& p = pairs[i];
+
+				if (!p.observer)
+					continue;
+
+				const PxVec3 from = p.observer->getGlobalPose().p + p.observerOffset;
+				const PxVec3 to = p.target->getGlobalPose().p + p.targetOffset;
+
+				if (!needsTest(p, from, to, epoch))
+					continue;
+
+				p.lastObserver = from;
+				p.lastTarget = to;
+				p.framesSinceTest = 0;
+				p.dirty = false;
+				p.blocker = nullptr;
+
+				const PxVec3 delta = to - from;
+				const float distance = delta.magnitude();
+
+				++rangeTested;
+
+				if (distance < PX_NORMALIZATION_EPSILON)
+				{
+					p.visible = true;
+					continue;
+				}
+
+				filter.ignoreActor = p.observer;
+				filter.otherActor = p.target;
+
+				PxRaycastBuffer buffer;
+				p.visible = !(scene->raycast(from, delta / distance, distance, buffer, hitFlags, filterData, &filter) && buffer.hasBlock);
+
+				if (!p.visible)
+				{
+					p.blocker = buffer.block.actor;
+					p.blockerPose = buffer.block.actor->getGlobalPose();
+					p.blockerEpoch = epoch;
+				}
+			}
+
+			tested.fetch_add(rangeTested, std::memory_order_relaxed);
+		});
+
+	nbTested = tested.load(std::memory_order_relaxed);
+
+	// Packed afterwards, ranges would race on shared words
+	std::fill(visibility.begin(), visibility.end(), 0ull);
+	for (uint32_t i = 0; i < (uint32_t)pairs.size(); ++i)
+		if (pairs[i].visible)
+			visibility[i >> 6] |= 1ull << (i & 63);
+}
\ No newline at end of file
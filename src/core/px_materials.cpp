@@ -0,0 +1,160 @@
+#include <core/px_materials.h>
+#include <core/px_physics.h>
+
+static uint64_t quantizeMaterialValue(float value) noexcept
+{
+	const float quantized = max(value, 0.0f) / PX_MATERIAL_QUANTIZATION_STEP + 0.5f;
+	return min((uint64_t)quantized, (uint64_t)0xFFFFF);
+}
+
+NODISCARD uint64_t openps::material_registry::makeKey(const material_desc& desc) noexcept
+{
+	// 20 bits per quantized value, 2 bits per combine mode
+	return quantizeMaterialValue(desc.staticFriction)
+		| (quantizeMaterialValue(desc.dynamicFriction) << 20)
+		| (quantizeMaterialValue(desc.restitution) << 40)
+		| ((uint64_t)(desc.frictionCombineMode & 0x3) << 60)
+		| ((uint64_t)(desc.restitutionCombineMode & 0x3) << 62);
+}
+
+NODISCARD physx::PxMaterial* openps::material_registry::acquire(const material_desc& desc) noexcept
+{
+	::std::unique_lock<::std::mutex> lock{ mutex };
+	return acquireInternal(desc);
+}
+
+NODISCARD physx::PxMaterial* openps::material_registry::acquireInternal(const material_desc& desc) noexcept
+{
+	const uint64_t key = makeKey(desc);
+
+	auto iter = materials.find(key);
+	if (iter != materials.end())
+	{
+		++iter->second.refCount;
+		return iter->second.material;
+	}
+
+	PxMaterial* material = physics_holder::physicsRef->getPhysicsImpl()->createMaterial(desc.staticFriction, desc.dynamicFriction, desc.restitution);
+
+	if (!material)
+	{
+		logger::log_error("Physics> Failed to create PxMaterial.");
+		return nullptr;
+	}
+
+	material->setFrictionCombineMode(desc.frictionCombineMode);
+	material->setRestitutionCombineMode(desc.restitutionCombineMode);
+
+	materials.emplace(key, material_entry{ material, 1 });
+	materialKeys.emplace(material, key);
+
+	return material;
+}
+
+NODISCARD physx::PxMaterial* openps::material_registry::acquire(PxMaterial* material) noexcept
+{
+	if (!material)
+		return nullptr;
+
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	auto keyIter = materialKeys.find(material);
+	if (keyIter == materialKeys.end())
+	{
+		logger::log_error("Physics> Material is not owned by the material registry.");
+		return nullptr;
+	}
+
+	++materials[keyIter->second].refCount;
+
+	return material;
+}
+
+void openps::material_registry::release(PxMaterial* material) noexcept
+{
+	if (!material)
+		return;
+
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	auto keyIter = materialKeys.find(material);
+	if (keyIter == materialKeys.end())
+		return;
+
+	auto iter = materials.find(keyIter->second);
+	if (--iter->second.refCount == 0)
+	{
+		materials.erase(iter);
+		materialKeys.erase(keyIter);
+		material->release();
+	}
+}
+
+physx::PxMaterial* openps::material_registry::createNamedMaterial(const std::string& name, const material_desc& desc) noexcept
+{
+	// One lock for lookup, creation and insertion, otherwise two callers can both create the name and one reference leaks
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	auto iter = namedMaterials.find(name);
+	if (iter != namedMaterials.end())
+	{
+		logger::log_error(("Physics> Named material '" + name + "' already exists.").c_str());
+		return iter->second;
+	}
+
+	PxMaterial* material = acquireInternal(desc);
+
+	if (material)
+		namedMaterials.emplace(name, material);
+
+	return material;
+}
+
+NODISCARD physx::PxMaterial* openps::material_registry::getNamedMaterial(const std::string& name) const noexcept
+{
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	auto iter = namedMaterials.find(name);
+	return iter != namedMaterials.end() ? iter->second : nullptr;
+}
+
+void openps::material_registry::releaseNamedMaterial(const std::string& name) noexcept
+{
+	PxMaterial* material = nullptr;
+
+	{
+		::std::unique_lock<::std::mutex> lock{ mutex };
+
+		auto iter = namedMaterials.find(name);
+		if (iter == namedMaterials.end())
+			return;
+
+		material = iter->second;
+		namedMaterials.erase(iter);
+	}
+
+	release(material);
+}
+
+NODISCARD uint32_t openps::material_registry::getRefCount(PxMaterial* material) const noexcept
+{
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	auto keyIter = materialKeys.find(material);
+	if (keyIter == materialKeys.end())
+		return 0;
+
+	return materials.at(keyIter->second).refCount;
+}
+
+void openps::material_registry::release() noexcept
+{
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	for (auto& [key, entry] : materials)
+		PX_RELEASE(entry.material)
+
+	materials.clear();
+	materialKeys.clear();
+	namedMaterials.clear();
+}
\ No newline at end of file
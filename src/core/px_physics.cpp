@@ -1,4 +1,5 @@
 #include <core/px_physics.h>
+#include <core/px_tasks.h>
 
 namespace openps
 {
@@ -8,7 +9,18 @@ namespace openps
 		physx::PxPairFlags& pairFlags, const void* constantBlock, physx::PxU32 constantBlockSize) noexcept
 	{
 		UNUSED(constantBlockSize);
-		UNUSED(constantBlock);
+
+		const collision_matrix* matrix = static_cast<const collision_matrix*>(constantBlock);
+
+		if (!matrix->canCollideMasks(filterData0.word0, filterData1.word0))
+			return physx::PxFilterFlag::eKILL;
+
+		const uint32_t mask0 = filterData0.word1 ? filterData0.word1 : PX_LAYER_MASK_ALL;
+		const uint32_t mask1 = filterData1.word1 ? filterData1.word1 : PX_LAYER_MASK_ALL;
+
+		if (!(mask0 & (filterData1.word0 ? filterData1.word0 : layerToMask(0)))
+			|| !(mask1 & (filterData0.word0 ? filterData0.word0 : layerToMask(0))))
+			return physx::PxFilterFlag::eSUPPRESS;
 
 		if (physx::PxFilterObjectIsTrigger(attributes0) || physx::PxFilterObjectIsTrigger(attributes1))
 		{
@@ -47,12 +59,33 @@ openps::physics::physics(const physics_desc& desc) noexcept
 	if (desc.logMessageFunc)
 		logger::logMessageFunc = desc.logMessageFunc;
 
+	sceneQueryAdapter.setGroups(desc.layerGroups);
+	useTreeOfPruners = desc.useTreeOfPruners;
+
+	allocatorCallback.pool.setTrackTypes(desc.trackAllocations);
+
+	allocator.setBudget(desc.scratchBudget, desc.scratchBudgetFunc, desc.scratchBudgetUserData);
+	allocator.setTrimPolicy(desc.scratchTrimPolicy);
+
+	frameArena.setTrimPolicy(desc.frameArenaTrimPolicy);
+
+	nbQueryThreads = desc.nbQueryThreads;
+
 	physics_holder::physicsRef = this;
 
 	initialize();
 }
 
 void openps::physics::update(float dt)
+{
+	// Held from simulate to fetchResults, readers and writers on other threads wait for the whole step
+	physics_lock_write lock{};
+
+	beginStep();
+	endStep(true);
+}
+
+void openps::physics::beginStep() noexcept
 {
 	const static float stepSize = 1.0f / (float)frameRate;
 	static constexpr uint64_t align = 16U;
@@ -61,6 +94,12 @@ void openps::physics::update(float dt)
 
 	static constexpr uint32_t scratchMemBlockSize = (uint32_t)MB(rawMemotySize);
 
+	if (isSimulating())
+	{
+		logger::log_error("Physics> beginStep called twice without endStep.");
+		return;
+	}
+
 	physics_lock_write lock{};
 
 	clearInternalQueues();
@@ -69,13 +108,47 @@ void openps::physics::update(float dt)
 
 	void* scratchMemBlock = allocator.allocate(scratchMemBlockSize, align, true);
 
-	scene->simulate(stepSize, NULL, scratchMemBlock, scratchMemBlockSize);
+	scene->simulate(stepSize, NULL, scratchMemBlock, scratchMemBlock ? scratchMemBlockSize : 0);
+
+	// The stepping thread would otherwise wait for itself, PhysX reports its writes during the step instead
+	stepThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+	simulating.store(true, std::memory_order_release);
+}
+
+bool openps::physics::endStep(bool block) noexcept
+{
+	if (!isSimulating())
+		return true;
+
+	// Waiting without the lock, queries keep running until the results are ready. Blocking in fetchResults
+	// under the write lock would stall every reader for the rest of the step.
+	if (!scene->checkResults(block))
+		return false;
+
+	// endStep may run on another thread than beginStep. Writers from the event callbacks in fetchResults
+	// mustn't wait for the step they run in.
+	stepThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+	{
+		physics_lock_write lock{};
+
+		scene->fetchResults(true);
+
+		scene->getTaskManager()->stopSimulation();
 
-	scene->fetchResults(true);
+		allocator.reset();
+
+		{
+			std::lock_guard<std::mutex> stepLock{ stepMutex };
+			simulating.store(false, std::memory_order_release);
+		}
+
+		stepThread.store(std::thread::id(), std::memory_order_relaxed);
+	}
 
-	scene->getTaskManager()->stopSimulation();
+	stepFinished.notify_all();
 
-	allocator.reset();
+	return true;
 }
 
 void openps::physics::addAggregate(PxAggregate* aggregate) noexcept
@@ -88,6 +161,7 @@ void openps::physics::removeAggregate(PxAggregate* aggregate) noexcept
 {
 	physics_lock_write lock{};
 	scene->removeAggregate(*aggregate);
+	invalidateQueryCaches();
 }
 
 void openps::physics::addActor(rigidbody* actor, PxRigidActor* ractor, bool addToScene) noexcept
@@ -106,18 +180,116 @@ void openps::physics::addActor(PxRigidActor* actor) noexcept
 	scene->addActor(*actor);
 }
 
+bool openps::physics::addActors(const PxPruningStructure& pruningStructure) noexcept
+{
+	if (sceneQuerySystem)
+	{
+		logger::log_error("Physics> PxPruningStructure can't be merged into the per-layer scene query system.");
+		return false;
+	}
+
+	physics_lock_write lock{};
+	return scene->addActors(pruningStructure);
+}
+
+void openps::physics::addActors(PxRigidActor* const* actors, uint32_t nbActors) noexcept
+{
+	physics_lock_write lock{};
+	scene->addActors(reinterpret_cast<PxActor* const*>(actors), nbActors);
+}
+
+bool openps::physics::addCollection(const PxCollection& collection) noexcept
+{
+	if (sceneQuerySystem)
+	{
+		for (PxU32 i = 0; i < collection.getNbObjects(); ++i)
+		{
+			if (collection.getObject(i).is<PxPruningStructure>())
+			{
+				logger::log_error("Physics> PxPruningStructure can't be merged into the per-layer scene query system.");
+				return false;
+			}
+		}
+	}
+
+	physics_lock_write lock{};
+	return scene->addCollection(collection);
+}
+
+void openps::physics::removeActors(PxRigidActor* const* actors, uint32_t nbActors) noexcept
+{
+	physics_lock_write lock{};
+	scene->removeActors(reinterpret_cast<PxActor* const*>(actors), nbActors);
+	invalidateQueryCaches();
+}
+
+void openps::physics::unregisterActors(PxRigidActor* const* ractors, uint32_t nbActors) noexcept
+{
+	physics_lock_write lock{};
+
+	for (uint32_t i = 0; i < nbActors; ++i)
+	{
+		auto iter = actorsMap.find(ractors[i]);
+		if (iter == actorsMap.end())
+			continue;
+
+		actors.erase(iter->second);
+		actorsMap.erase(iter);
+	}
+}
+
 void openps::physics::removeActor(rigidbody* actor) noexcept
 {
 	physics_lock_write lock{};
 	actors.erase(actor);
 	actorsMap.erase(actor->getRigidActor());
-	scene->removeActor(*actor->getRigidActor());
+
+	// Pooled and never added actors aren't in the scene
+	if (actor->getRigidActor()->getScene())
+		scene->removeActor(*actor->getRigidActor());
+	materials.release(actor->getMaterial());
+	releaseCachedShapes(actor->getRigidActor());
+	invalidateQueryCaches();
+}
+
+void openps::physics::releaseCachedShapes(PxRigidActor* actor) noexcept
+{
+	static constexpr uint32_t chunkSize = 16;
+
+	PxShape* actorShapes[chunkSize];
+
+	const uint32_t nbShapes = actor->getNbShapes();
+
+	for (uint32_t first = 0; first < nbShapes; first += chunkSize)
+	{
+		const uint32_t count = actor->getShapes(actorShapes, chunkSize, first);
+
+		for (uint32_t i = 0; i < count; ++i)
+			shapes.release(actorShapes[i]);
+	}
 }
 
 void openps::physics::reomoveActor(PxRigidActor* actor) noexcept
 {
 	physics_lock_write lock{};
 	scene->removeActor(*actor);
+	invalidateQueryCaches();
+}
+
+void openps::physics::setLayerCollision(uint8_t layer1, uint8_t layer2, bool collide) noexcept
+{
+	physics_lock_write lock{};
+
+	if (collisionMatrix.canCollide(layer1, layer2) == collide)
+		return;
+
+	collisionMatrix.setCollision(layer1, layer2, collide);
+	scene->setFilterShaderData(&collisionMatrix, sizeof(collision_matrix));
+
+	// Parked pool actors are registered but not in the scene
+	for (auto& [ractor, rb] : actorsMap)
+		if (ractor->is<PxRigidDynamic>() && ractor->getScene())
+			scene->resetFiltering(*ractor);
 }
 
 void openps::physics::lockRead() noexcept
@@ -132,7 +304,19 @@ void openps::physics::unlockRead() noexcept
 
 void openps::physics::lockWrite() noexcept
 {
-	scene->lockWrite();
+	// simulating only changes under the write lock, so checking it while holding the lock is race free
+	while (true)
+	{
+		scene->lockWrite();
+
+		if (!isSimulating() || stepThread.load(std::memory_order_relaxed) == std::this_thread::get_id())
+			return;
+
+		scene->unlockWrite();
+
+		std::unique_lock<std::mutex> stepLock{ stepMutex };
+		stepFinished.wait(stepLock, [this]() { return !isSimulating(); });
+	}
 }
 
 void openps::physics::unlockWrite() noexcept
@@ -140,126 +324,834 @@ void openps::physics::unlockWrite() noexcept
 	scene->unlockWrite();
 }
 
-const openps::raycast_info openps::physics::raycast(rigidbody* rb, const PxVec3& dir, float maxDist, bool hitTriggers, uint32_t layerMask) noexcept
+const openps::raycast_info openps::physics::raycast(rigidbody* rb, const PxVec3& dir, float maxDist, bool hitTriggers, uint32_t layerMask, query_cache* cache) noexcept
+{
+	raycast_hit hit;
+
+	if (!raycast(rb->getPosition(), dir, hit, maxDist, hitTriggers, layerMask, rb->getRigidActor(), cache))
+		return raycast_info();
+
+	return
+	{
+		hit.actor,
+		hit.distance,
+		1U,
+		hit.position
+	};
+}
+
+bool openps::physics::raycast(const PxVec3& origin, const PxVec3& dir, raycast_hit& hit, float maxDist, bool hitTriggers, uint32_t layerMask,
+	const PxRigidActor* ignoreActor, query_cache* cache) noexcept
 {
 	PX_SCENE_QUERY_SETUP(true);
+
+	query_filter filter;
+	filter.ignoreActor = ignoreActor;
+
+	hit = raycast_hit();
+
+	physics_lock_read lock{};
+
 	PxRaycastBuffer buffer;
-	bool status = scene->raycast(rb->getPosition(), dir, maxDist, buffer, hitFlags, PxQueryFilterData(), &queryFilter);
+	const bool blocked = scene->raycast(origin, dir, maxDist, buffer, hitFlags, filterData, &filter, beginCachedQuery(cache)) && buffer.hasBlock;
+
+	endCachedQuery(cache, blocked ? &buffer.block : nullptr);
+
+	if (!blocked)
+		return false;
+
+	fillHit(buffer.block, hit);
+
+	return true;
+}
+
+namespace openps
+{
+	// Keeps the closest hits in caller memory, PhysX reports touches in no particular order
+	template<typename HitType, typename ResultType>
+	struct closest_hits_collector : PxHitCallback<HitType>
+	{
+		closest_hits_collector(const physics& physicsRef, std::span<ResultType> results) noexcept
+			: PxHitCallback<HitType>(touchBuffer, PX_NB_MAX_RAYCAST_HITS), physicsRef(physicsRef), results(results) {}
+
+		PxAgain processTouches(const HitType* buffer, PxU32 nbHits) override
+		{
+			for (PxU32 i = 0; i < nbHits; ++i)
+			{
+				uint32_t index = count;
+
+				if (count < results.size())
+				{
+					++count;
+				}
+				else
+				{
+					index = 0;
+					for (uint32_t j = 1; j < count; ++j)
+						if (results[j].distance > results[index].distance)
+							index = j;
+
+					if (results[index].distance <= buffer[i].distance)
+						continue;
+				}
+
+				physicsRef.fillHit(buffer[i], results[index]);
+			}
+
+			return true;
+		}
+
+		HitType touchBuffer[PX_NB_MAX_RAYCAST_HITS];
+
+		const physics& physicsRef;
+		std::span<ResultType> results;
+		uint32_t count = 0;
+	};
+}
+
+uint32_t openps::physics::raycastAll(const PxVec3& origin, const PxVec3& dir, std::span<raycast_hit> hits, float maxDist, bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	if (hits.empty())
+		return 0;
+
+	PX_SCENE_QUERY_SETUP(false);
+
+	query_filter filter;
+	filter.ignoreActor = ignoreActor;
+
+	closest_hits_collector<PxRaycastHit, raycast_hit> collector(*this, hits);
 
-	if (status)
 	{
-		uint32_t nb = buffer.getNbAnyHits();
-		uint32_t index = 0;
-		if (nb > 1)
-			index = 1;
-		const auto& hitInfo1 = buffer.getAnyHit(index);
+		physics_lock_read lock{};
+		scene->raycast(origin, dir, maxDist, collector, hitFlags, filterData, &filter);
+	}
 
-		auto actor = actorsMap[hitInfo1.actor];
+	std::sort(hits.begin(), hits.begin() + collector.count, [](const raycast_hit& a, const raycast_hit& b) { return a.distance < b.distance; });
 
-		if (actor != rb)
-			return
+	return collector.count;
+}
+
+void openps::physics::raycastBatch(std::span<const raycast_ray> rays, std::span<raycast_hit> hits, bool hitTriggers) noexcept
+{
+	ASSERT(hits.size() >= rays.size());
+
+	parallelFor(queryDispatcher, (uint32_t)rays.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
 		{
-			actor,
-			hitInfo1.distance,
-			buffer.getNbAnyHits(),
-			PxVec3(hitInfo1.position.x, hitInfo1.position.y, hitInfo1.position.z)
-		};
-		else if (buffer.getNbAnyHits() > 1)
+			physics_lock_read lock{};
+
+			PX_SCENE_QUERY_SETUP_MASK(true, PX_LAYER_MASK_ALL);
+
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const raycast_ray& ray = rays[i];
+				raycast_hit& result = hits[i];
+
+				result = raycast_hit();
+				filterData.data.word0 = ray.layerMask;
+
+				PxRaycastBuffer buffer;
+				const bool blocked = scene->raycast(ray.origin, ray.direction, ray.maxDistance, buffer, hitFlags, filterData, &queryFilter,
+					beginCachedQuery(ray.cache)) && buffer.hasBlock;
+
+				endCachedQuery(ray.cache, blocked ? &buffer.block : nullptr);
+
+				if (blocked)
+					fillHit(buffer.block, result);
+			}
+		});
+}
+
+bool openps::physics::sweep(const PxGeometry& geometry, const PxTransform& pose, const PxVec3& dir, float maxDist, sweep_hit& hit,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor, query_cache* cache) noexcept
+{
+	PX_SCENE_QUERY_SETUP_SWEEP_CAST();
+
+	query_filter filter;
+	filter.ignoreActor = ignoreActor;
+
+	hit = sweep_hit();
+
+	physics_lock_read lock{};
+
+	const bool blocked = scene->sweep(geometry, pose, dir, maxDist, buffer, hitFlags, filterData, &filter, beginCachedQuery(cache)) && buffer.hasBlock;
+
+	endCachedQuery(cache, blocked ? &buffer.block : nullptr);
+
+	if (!blocked)
+		return false;
+
+	fillHit(buffer.block, hit);
+
+	return true;
+}
+
+uint32_t openps::physics::sweepAll(const PxGeometry& geometry, const PxTransform& pose, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	if (hits.empty())
+		return 0;
+
+	PX_SCENE_QUERY_SETUP_SWEEP_CAST_ALL();
+
+	query_filter filter;
+	filter.ignoreActor = ignoreActor;
+
+	{
+		physics_lock_read lock{};
+		scene->sweep(geometry, pose, dir, maxDist, buffer, hitFlags, filterData, &filter);
+	}
+
+	std::sort(hits.begin(), hits.begin() + buffer.count, [](const sweep_hit& a, const sweep_hit& b) { return a.distance < b.distance; });
+
+	return buffer.count;
+}
+
+bool openps::physics::sweepSphere(const PxVec3& center, float radius, const PxVec3& dir, float maxDist, sweep_hit& hit,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	return sweep(PxSphereGeometry(radius), PxTransform(center), dir, maxDist, hit, hitTriggers, layerMask, ignoreActor);
+}
+
+uint32_t openps::physics::sweepSphereAll(const PxVec3& center, float radius, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	return sweepAll(PxSphereGeometry(radius), PxTransform(center), dir, maxDist, hits, hitTriggers, layerMask, ignoreActor);
+}
+
+bool openps::physics::sweepBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, const PxVec3& dir, float maxDist, sweep_hit& hit,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	return sweep(PxBoxGeometry(halfExtents), PxTransform(center, rotation), dir, maxDist, hit, hitTriggers, layerMask, ignoreActor);
+}
+
+uint32_t openps::physics::sweepBoxAll(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	return sweepAll(PxBoxGeometry(halfExtents), PxTransform(center, rotation), dir, maxDist, hits, hitTriggers, layerMask, ignoreActor);
+}
+
+bool openps::physics::sweepCapsule(const PxVec3& center, float radius, float halfHeight, const PxQuat& rotation, const PxVec3& dir, float maxDist, sweep_hit& hit,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	return sweep(PxCapsuleGeometry(radius, halfHeight), PxTransform(center, rotation), dir, maxDist, hit, hitTriggers, layerMask, ignoreActor);
+}
+
+uint32_t openps::physics::sweepCapsuleAll(const PxVec3& center, float radius, float halfHeight, const PxQuat& rotation, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	return sweepAll(PxCapsuleGeometry(radius, halfHeight), PxTransform(center, rotation), dir, maxDist, hits, hitTriggers, layerMask, ignoreActor);
+}
+
+bool openps::physics::sweepConvex(PxConvexMesh* mesh, const PxMeshScale& scale, const PxTransform& pose, const PxVec3& dir, float maxDist, sweep_hit& hit,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	return sweep(PxConvexMeshGeometry(mesh, scale), pose, dir, maxDist, hit, hitTriggers, layerMask, ignoreActor);
+}
+
+uint32_t openps::physics::sweepConvexAll(PxConvexMesh* mesh, const PxMeshScale& scale, const PxTransform& pose, const PxVec3& dir, float maxDist, std::span<sweep_hit> hits,
+	bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	return sweepAll(PxConvexMeshGeometry(mesh, scale), pose, dir, maxDist, hits, hitTriggers, layerMask, ignoreActor);
+}
+
+void openps::physics::sweepBatch(std::span<const sweep_query> queries, std::span<sweep_hit> hits, bool hitTriggers) noexcept
+{
+	ASSERT(hits.size() >= queries.size());
+
+	parallelFor(queryDispatcher, (uint32_t)queries.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
 		{
-			const auto& hitInfo2 = buffer.getAnyHit(1);
+			physics_lock_read lock{};
+
+			PX_SCENE_QUERY_SETUP_MASK(true, PX_LAYER_MASK_ALL);
 
-			actor = actorsMap[hitInfo2.actor];
+			query_filter filter;
 
-			return
+			for (uint32_t i = begin; i < end; ++i)
 			{
-				actor,
-				hitInfo2.distance,
-				buffer.getNbAnyHits(),
-				PxVec3(hitInfo2.position.x, hitInfo2.position.y, hitInfo2.position.z)
-			};
+				const sweep_query& query = queries[i];
+				sweep_hit& result = hits[i];
+
+				result = sweep_hit();
+				filterData.data.word0 = query.layerMask;
+				filter.ignoreActor = query.ignoreActor;
+
+				PxSweepBuffer buffer;
+				const bool blocked = scene->sweep(query.geometry.any(), query.pose, query.direction, query.maxDistance, buffer, hitFlags, filterData, &filter,
+					beginCachedQuery(query.cache)) && buffer.hasBlock;
+
+				endCachedQuery(query.cache, blocked ? &buffer.block : nullptr);
+
+				if (blocked)
+					fillHit(buffer.block, result);
+			}
+		});
+}
+
+namespace openps
+{
+	// Refines overlap candidates to the closest shape of a sphere query around point
+	struct closest_point_collector : PxHitCallback<PxOverlapHit>
+	{
+		closest_point_collector(const PxVec3& point, float maxDist) noexcept
+			: PxHitCallback<PxOverlapHit>(touchBuffer, PX_NB_MAX_RAYCAST_HITS), point(point), bestDistanceSq(maxDist * maxDist) {}
+
+		PxAgain processTouches(const PxOverlapHit* buffer, PxU32 nbHits) override
+		{
+			for (PxU32 i = 0; i < nbHits; ++i)
+			{
+				const PxOverlapHit& hit = buffer[i];
+
+				PxVec3 closest;
+				const PxReal distanceSq = PxGeometryQuery::pointDistance(point, hit.shape->getGeometry(),
+					PxShapeExt::getGlobalPose(*hit.shape, *hit.actor), &closest);
+
+				// Unsupported geometry
+				if (distanceSq < 0.0f || distanceSq > bestDistanceSq)
+					continue;
+
+				bestDistanceSq = distanceSq;
+				bestClosest = distanceSq > 0.0f ? closest : point;
+				bestActor = hit.actor;
+				bestShape = hit.shape;
+
+				// Inside a shape, nothing can be closer
+				if (distanceSq == 0.0f)
+					return false;
+			}
+
+			return true;
 		}
+
+		PxOverlapHit touchBuffer[PX_NB_MAX_RAYCAST_HITS];
+
+		PxVec3 point;
+
+		PxReal bestDistanceSq;
+		PxVec3 bestClosest = PxVec3(0.0f);
+		PxRigidActor* bestActor = nullptr;
+		PxShape* bestShape = nullptr;
+	};
+}
+
+bool openps::physics::closestPoint(const PxVec3& point, float maxDist, distance_hit& hit, bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	physics_lock_read lock{};
+	return closestPointInternal(point, maxDist, hit, hitTriggers, layerMask, ignoreActor);
+}
+
+bool openps::physics::closestPointInternal(const PxVec3& point, float maxDist, distance_hit& hit, bool hitTriggers, uint32_t layerMask, const PxRigidActor* ignoreActor) noexcept
+{
+	PX_SCENE_QUERY_FILTER_SETUP(false);
+
+	query_filter filter;
+	filter.ignoreActor = ignoreActor;
+
+	hit = distance_hit();
+
+	closest_point_collector collector(point, maxDist);
+
+	scene->overlap(PxSphereGeometry(maxDist), PxTransform(point), collector, filterData, &filter);
+
+	if (!collector.bestActor)
+		return false;
+
+	hit.actor = findRigidbody(collector.bestActor);
+	hit.rigidActor = collector.bestActor;
+	hit.shape = collector.bestShape;
+	hit.closestPoint = collector.bestClosest;
+	hit.distance = PxSqrt(collector.bestDistanceSq);
+
+	return true;
+}
+
+void openps::physics::closestPointBatch(std::span<const distance_query> queries, std::span<distance_hit> hits, bool hitTriggers) noexcept
+{
+	ASSERT(hits.size() >= queries.size());
+
+	parallelFor(queryDispatcher, (uint32_t)queries.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+		{
+			physics_lock_read lock{};
+
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const distance_query& query = queries[i];
+				closestPointInternal(query.point, query.maxDistance, hits[i], hitTriggers, query.layerMask, query.ignoreActor);
+			}
+		});
+}
+
+// Slots of actors removed while the ranges ran get empty bounds
+static void writeBounds(openps::bounds_soa& out, uint32_t index, physx::PxActor* actor) noexcept
+{
+	const physx::PxBounds3 bounds = actor ? actor->getWorldBounds() : physx::PxBounds3::empty();
+
+	out.minX[index] = bounds.minimum.x;
+	out.minY[index] = bounds.minimum.y;
+	out.minZ[index] = bounds.minimum.z;
+	out.maxX[index] = bounds.maximum.x;
+	out.maxY[index] = bounds.maximum.y;
+	out.maxZ[index] = bounds.maximum.z;
+
+	if (out.handles)
+		out.handles[index] = actor && actor->userData ? *static_cast<const uint32_t*>(actor->userData) : 0xFFFFFFFF;
+
+	if (out.actors)
+		out.actors[index] = actor ? actor->is<physx::PxRigidActor>() : nullptr;
+}
+
+uint32_t openps::physics::exportBounds(bounds_soa& out, bool activeOnly) noexcept
+{
+	const PxActorTypeFlags rigidTypes = PxActorTypeFlag::eRIGID_STATIC | PxActorTypeFlag::eRIGID_DYNAMIC;
+	static constexpr uint32_t chunkSize = 256;
+
+	uint32_t count = 0;
+
+	{
+		physics_lock_read lock{};
+
+		PxU32 nbActive = 0;
+		if (activeOnly)
+			scene->getActiveActors(nbActive);
+
+		count = min(activeOnly ? (uint32_t)nbActive : (uint32_t)scene->getNbActors(rigidTypes), out.capacity);
 	}
 
-	return raycast_info();
+	// Every range locks on its own, so the actor list is fetched again inside and may have shrunk in between
+	if (activeOnly)
+	{
+		parallelFor(queryDispatcher, count, PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+			{
+				physics_lock_read lock{};
+
+				PxU32 nbActive = 0;
+				PxActor** active = scene->getActiveActors(nbActive);
+
+				for (uint32_t i = begin; i < end; ++i)
+					writeBounds(out, i, i < nbActive ? active[i] : nullptr);
+			});
+
+		return count;
+	}
+
+	// Ranges fetch their own actor chunks by start index instead of copying the actor list up front
+	parallelFor(queryDispatcher, count, chunkSize, [&](uint32_t begin, uint32_t end)
+		{
+			physics_lock_read lock{};
+
+			PxActor* chunk[chunkSize];
+
+			for (uint32_t first = begin; first < end; first += chunkSize)
+			{
+				const uint32_t nbRequested = min(chunkSize, end - first);
+				const uint32_t nbChunk = scene->getActors(rigidTypes, chunk, nbRequested, first);
+
+				for (uint32_t i = 0; i < nbRequested; ++i)
+					writeBounds(out, first + i, i < nbChunk ? chunk[i] : nullptr);
+			}
+		});
+
+	return count;
 }
 
-const bool openps::physics::checkBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, bool hitTriggers, uint32_t layerMask) noexcept
+void openps::physics::groundProbeBatch(std::span<const ground_probe> probes, ground_probe_results& results, const PxVec3& up, bool hitTriggers) noexcept
+{
+	ASSERT(results.capacity >= probes.size());
+
+	// PhysX capsules lie along x
+	const PxQuat rotation = PxShortestRotation(PxVec3(1.0f, 0.0f, 0.0f), up);
+	const PxVec3 down = -up;
+
+	parallelFor(queryDispatcher, (uint32_t)probes.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+		{
+			physics_lock_read lock{};
+
+			PX_SCENE_QUERY_SETUP_MASK(true, PX_LAYER_MASK_ALL);
+
+			query_filter filter;
+
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const ground_probe& probe = probes[i];
+
+				filterData.data.word0 = probe.layerMask;
+				filter.ignoreActor = probe.ignoreActor;
+
+				PxSweepBuffer buffer;
+				// With eMTD a capsule starting inside the ground reports the depenetration normal and a negative distance
+				const bool grounded = scene->sweep(PxCapsuleGeometry(probe.radius, probe.halfHeight), PxTransform(probe.center, rotation),
+					down, probe.maxStep, buffer, hitFlags | PxHitFlag::eMTD, filterData, &filter) && buffer.hasBlock;
+
+				results.grounded[i] = grounded;
+
+				if (!grounded)
+				{
+					results.handles[i] = 0xFFFFFFFF;
+					results.normals[i] = up;
+					results.distances[i] = probe.maxStep;
+					results.walkable[i] = false;
+					continue;
+				}
+
+				const PxSweepHit& hit = buffer.block;
+
+				results.handles[i] = hit.actor->userData ? *static_cast<const uint32_t*>(hit.actor->userData) : 0xFFFFFFFF;
+				results.normals[i] = hit.normal;
+				results.distances[i] = hit.distance;
+				results.walkable[i] = hit.normal.dot(up) >= PxCos(probe.maxSlopeAngle);
+			}
+		});
+}
+
+const bool openps::physics::checkBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, bool hitTriggers, uint32_t layerMask, query_cache* cache) noexcept
 {
 	PX_SCENE_QUERY_SETUP_CHECK();
-	std::vector<uint32_t*> results;
 	const PxTransform pose(center, rotation);
 	const PxBoxGeometry geometry(halfExtents);
 
-	return scene->overlap(geometry, pose, buffer, filterData, &queryFilter);
+	physics_lock_read lock{};
+	const bool overlapping = scene->overlap(geometry, pose, buffer, filterData, &queryFilter, beginCachedQuery(cache)) && buffer.hasBlock;
+
+	endCachedQuery(cache, overlapping ? &buffer.block : nullptr);
+
+	return overlapping;
 }
 
-const bool openps::physics::checkSphere(const PxVec3& center, const float radius, bool hitTriggers, uint32_t layerMask) noexcept
+const bool openps::physics::checkSphere(const PxVec3& center, const float radius, bool hitTriggers, uint32_t layerMask, query_cache* cache) noexcept
 {
 	PX_SCENE_QUERY_SETUP_CHECK();
-	std::vector<uint32_t*> results;
 	const PxTransform pose(center);
 	const PxSphereGeometry geometry(radius);
 
-	return scene->overlap(geometry, pose, buffer, filterData, &queryFilter);
+	physics_lock_read lock{};
+	const bool overlapping = scene->overlap(geometry, pose, buffer, filterData, &queryFilter, beginCachedQuery(cache)) && buffer.hasBlock;
+
+	endCachedQuery(cache, overlapping ? &buffer.block : nullptr);
+
+	return overlapping;
 }
 
-const bool openps::physics::checkCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, bool hitTriggers, uint32_t layerMask) noexcept
+const bool openps::physics::checkCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, bool hitTriggers, uint32_t layerMask, query_cache* cache) noexcept
 {
 	PX_SCENE_QUERY_SETUP_CHECK();
-	std::vector<uint32_t*> results;
 	const PxTransform pose(center, rotation);
 	const PxCapsuleGeometry geometry(radius, halfHeight);
-	return scene->overlap(geometry, pose, buffer, filterData, &queryFilter);
+
+	physics_lock_read lock{};
+	const bool overlapping = scene->overlap(geometry, pose, buffer, filterData, &queryFilter, beginCachedQuery(cache)) && buffer.hasBlock;
+
+	endCachedQuery(cache, overlapping ? &buffer.block : nullptr);
+
+	return overlapping;
 }
 
-const openps::overlap_info openps::physics::overlapCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, bool hitTriggers, uint32_t layerMask) noexcept
+namespace openps
 {
-	PX_SCENE_QUERY_SETUP_OVERLAP();
-	std::vector<uint32_t*> results;
-	const PxTransform pose(center, rotation);
-	const PxCapsuleGeometry geometry(radius, halfHeight);
-	if (!scene->overlap(geometry, pose, buffer, filterData, &queryFilter))
-		return overlap_info(false, results);
+	// Overlaps report one touch per shape. Compound actors are remembered so they are reported once,
+	// single-shape actors can't repeat and skip the lookup.
+	struct overlap_actor_set
+	{
+		NODISCARD bool insert(const PxRigidActor* actor) noexcept
+		{
+			if (!actor || actor->getNbShapes() <= 1)
+				return true;
+
+			if (std::find(compounds.begin(), compounds.end(), actor) != compounds.end())
+				return false;
+
+			compounds.push_back(actor);
+			return true;
+		}
+
+		std::vector<const PxRigidActor*> compounds;
+	};
+
+	// Streams overlap touches into a sink, the touch buffer is only a staging area so nothing gets truncated
+	template<typename Sink>
+	struct overlap_collector : PxHitCallback<PxOverlapHit>
+	{
+		overlap_collector(Sink&& sink) noexcept
+			: PxHitCallback<PxOverlapHit>(touchBuffer, PX_NB_MAX_RAYCAST_HITS), sink(sink) {}
+
+		PxAgain processTouches(const PxOverlapHit* buffer, PxU32 nbHits) override
+		{
+			for (PxU32 i = 0; i < nbHits; ++i)
+			{
+				if (!actors.insert(buffer[i].actor))
+					continue;
+
+				sink(count++, buffer[i].actor ? static_cast<uint32_t*>(buffer[i].actor->userData) : nullptr);
+			}
+
+			return true;
+		}
+
+		PxOverlapHit touchBuffer[PX_NB_MAX_RAYCAST_HITS];
+
+		Sink sink;
+		overlap_actor_set actors;
+		uint32_t count = 0;
+	};
 
-	PX_SCENE_QUERY_COLLECT_OVERLAP();
+	struct overlap_counter : PxHitCallback<PxOverlapHit>
+	{
+		overlap_counter() noexcept
+			: PxHitCallback<PxOverlapHit>(touchBuffer, PX_NB_MAX_RAYCAST_HITS) {}
+
+		PxAgain processTouches(const PxOverlapHit* buffer, PxU32 nbHits) override
+		{
+			for (PxU32 i = 0; i < nbHits; ++i)
+				if (actors.insert(buffer[i].actor))
+					++count;
 
-	return overlap_info(true, results);
+			return true;
+		}
+
+		PxOverlapHit touchBuffer[PX_NB_MAX_RAYCAST_HITS];
+
+		overlap_actor_set actors;
+		uint32_t count = 0;
+	};
 }
 
-const openps::overlap_info openps::physics::overlapBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, bool hitTriggers, uint32_t layerMask) noexcept
+uint32_t openps::physics::overlap(const PxGeometry& geometry, const PxTransform& pose, std::span<uint32_t*> results, bool hitTriggers, uint32_t layerMask) noexcept
 {
-	PX_SCENE_QUERY_SETUP_OVERLAP();
-	std::vector<uint32_t*> results;
-	const PxTransform pose(center, rotation);
-	const PxBoxGeometry geometry(halfExtents);
+	PX_SCENE_QUERY_FILTER_SETUP(false);
+
+	overlap_collector collector([results](uint32_t index, uint32_t* handle)
+		{
+			if (index < results.size())
+				results[index] = handle;
+		});
+
+	physics_lock_read lock{};
+	scene->overlap(geometry, pose, collector, filterData, &queryFilter);
+
+	return collector.count;
+}
+
+uint32_t openps::physics::overlap(const PxGeometry& geometry, const PxTransform& pose, overlap_buffer& results, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	PX_SCENE_QUERY_FILTER_SETUP(false);
+
+	results.clear();
 
-	if (!scene->overlap(geometry, pose, buffer, filterData, &queryFilter))
-		return overlap_info(false, results);
+	overlap_collector collector([&results](uint32_t index, uint32_t* handle) { UNUSED(index); results.push(handle); });
 
-	PX_SCENE_QUERY_COLLECT_OVERLAP();
+	physics_lock_read lock{};
+	scene->overlap(geometry, pose, collector, filterData, &queryFilter);
 
-	return overlap_info(true, results);
+	return collector.count;
+}
+
+uint32_t openps::physics::overlapCount(const PxGeometry& geometry, const PxTransform& pose, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	PX_SCENE_QUERY_FILTER_SETUP(false);
+
+	overlap_counter counter;
+
+	physics_lock_read lock{};
+	scene->overlap(geometry, pose, counter, filterData, &queryFilter);
+
+	return counter.count;
+}
+
+uint32_t openps::physics::overlapSphere(const PxVec3& center, const float radius, std::span<uint32_t*> results, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	return overlap(PxSphereGeometry(radius), PxTransform(center), results, hitTriggers, layerMask);
+}
+
+uint32_t openps::physics::overlapSphere(const PxVec3& center, const float radius, overlap_buffer& results, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	return overlap(PxSphereGeometry(radius), PxTransform(center), results, hitTriggers, layerMask);
+}
+
+uint32_t openps::physics::overlapBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, std::span<uint32_t*> results, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	return overlap(PxBoxGeometry(halfExtents), PxTransform(center, rotation), results, hitTriggers, layerMask);
+}
+
+uint32_t openps::physics::overlapBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, overlap_buffer& results, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	return overlap(PxBoxGeometry(halfExtents), PxTransform(center, rotation), results, hitTriggers, layerMask);
+}
+
+uint32_t openps::physics::overlapCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, std::span<uint32_t*> results, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	return overlap(PxCapsuleGeometry(radius, halfHeight), PxTransform(center, rotation), results, hitTriggers, layerMask);
+}
+
+uint32_t openps::physics::overlapCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, overlap_buffer& results, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	return overlap(PxCapsuleGeometry(radius, halfHeight), PxTransform(center, rotation), results, hitTriggers, layerMask);
+}
+
+static openps::overlap_info collectOverlap(openps::physics& physics, const physx::PxGeometry& geometry, const physx::PxTransform& pose, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	openps::overlap_buffer buffer;
+	physics.overlap(geometry, pose, buffer, hitTriggers, layerMask);
+
+	const auto results = buffer.results();
+	return openps::overlap_info(!results.empty(), std::vector<uint32_t*>(results.begin(), results.end()));
+}
+
+const openps::overlap_info openps::physics::overlapCapsule(const PxVec3& center, const float radius, const float halfHeight, const PxQuat& rotation, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	return collectOverlap(*this, PxCapsuleGeometry(radius, halfHeight), PxTransform(center, rotation), hitTriggers, layerMask);
+}
+
+const openps::overlap_info openps::physics::overlapBox(const PxVec3& center, const PxVec3& halfExtents, const PxQuat& rotation, bool hitTriggers, uint32_t layerMask) noexcept
+{
+	return collectOverlap(*this, PxBoxGeometry(halfExtents), PxTransform(center, rotation), hitTriggers, layerMask);
 }
 
 const openps::overlap_info openps::physics::overlapSphere(const PxVec3& center, const float radius, bool hitTriggers, uint32_t layerMask) noexcept
 {
-	PX_SCENE_QUERY_SETUP_OVERLAP();
-	std::vector<uint32_t*> results;
-	const PxTransform pose(center);
-	const PxSphereGeometry geometry(radius);
+	return collectOverlap(*this, PxSphereGeometry(radius), PxTransform(center), hitTriggers, layerMask);
+}
+
+NODISCARD openps::query_cache_stats openps::physics::getQueryCacheStats() const noexcept
+{
+	query_cache_stats stats;
+	stats.queries = queryCacheQueries.load(std::memory_order_relaxed);
+	stats.hits = queryCacheHits.load(std::memory_order_relaxed);
+	stats.misses = queryCacheMisses.load(std::memory_order_relaxed);
+	stats.invalidations = queryCacheInvalidations.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+void openps::physics::resetQueryCacheStats() noexcept
+{
+	queryCacheQueries.store(0, std::memory_order_relaxed);
+	queryCacheHits.store(0, std::memory_order_relaxed);
+	queryCacheMisses.store(0, std::memory_order_relaxed);
+	queryCacheInvalidations.store(0, std::memory_order_relaxed);
+}
+
+void openps::physics::logAllocationStats(uint32_t maxTypes) const noexcept
+{
+	std::vector<allocation_type_stats> stats;
+	getAllocationStats(stats);
 
-	if (!scene->overlap(geometry, pose, buffer, filterData, &queryFilter))
-		return overlap_info(false, results);
+	std::stringstream stream{};
+	stream << "Physics> " << getAllocatedBytes() << " bytes allocated, " << allocatorCallback.pool.getPooledBytes() << " bytes pooled.";
 
-	PX_SCENE_QUERY_COLLECT_OVERLAP();
+	for (uint32_t i = 0; i < min(maxTypes, (uint32_t)stats.size()); ++i)
+	{
+		stream << "\n\t" << stats[i].typeName << ": " << stats[i].liveBytes << " bytes in " << stats[i].liveAllocations
+			<< " blocks, peak " << stats[i].peakBytes << ", " << stats[i].totalAllocations << " allocations";
+	}
 
-	return overlap_info(true, results);
+	logger::log_message(stream.str().c_str());
+}
+
+NODISCARD const physx::PxQueryCache* openps::physics::beginCachedQuery(query_cache* cache) noexcept
+{
+	if (!cache)
+		return nullptr;
+
+	++cache->stats.queries;
+	queryCacheQueries.fetch_add(1, std::memory_order_relaxed);
+
+	if (!cache->cache.shape)
+		return nullptr;
+
+	// The cached shape may have been detached or released, PhysX would dereference it
+	if (cache->epoch != queryCacheEpoch.load(std::memory_order_relaxed))
+	{
+		cache->reset();
+		++cache->stats.invalidations;
+		queryCacheInvalidations.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	return &cache->cache;
+}
+
+void openps::physics::endCachedQuery(query_cache* cache, const PxActorShape* hit) noexcept
+{
+	if (!cache)
+		return;
+
+	if (hit && cache->cache.shape == hit->shape && cache->cache.actor == hit->actor)
+	{
+		++cache->stats.hits;
+		queryCacheHits.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	++cache->stats.misses;
+	queryCacheMisses.fetch_add(1, std::memory_order_relaxed);
+
+	if (!hit)
+	{
+		cache->reset();
+		return;
+	}
+
+	cache->cache.shape = hit->shape;
+	cache->cache.actor = hit->actor;
+	cache->epoch = queryCacheEpoch.load(std::memory_order_relaxed);
+}
+
+NODISCARD openps::rigidbody* openps::physics::findRigidbody(const PxRigidActor* actor) const noexcept
+{
+	auto iter = actorsMap.find(const_cast<PxRigidActor*>(actor));
+	return iter != actorsMap.end() ? iter->second : nullptr;
+}
+
+static physx::PxMaterial* getHitMaterial(const physx::PxQueryHit& hit, const physx::PxShape* shape) noexcept
+{
+	physx::PxMaterial* material = nullptr;
+
+	if (!shape)
+		return material;
+
+	if (hit.faceIndex != 0xFFFFFFFF)
+	{
+		physx::PxBaseMaterial* baseMaterial = shape->getMaterialFromInternalFaceIndex(hit.faceIndex);
+		material = baseMaterial ? baseMaterial->is<physx::PxMaterial>() : nullptr;
+	}
+	else
+		shape->getMaterials(&material, 1);
+
+	return material;
+}
+
+void openps::physics::fillHit(const PxRaycastHit& hit, raycast_hit& result) const noexcept
+{
+	result.actor = findRigidbody(hit.actor);
+	result.rigidActor = hit.actor;
+	result.position = hit.position;
+	result.normal = hit.normal;
+	result.distance = hit.distance;
+	result.u = hit.u;
+	result.v = hit.v;
+	result.faceIndex = hit.faceIndex;
+	result.material = getHitMaterial(hit, hit.shape);
+}
+
+void openps::physics::fillHit(const PxSweepHit& hit, sweep_hit& result) const noexcept
+{
+	result.actor = findRigidbody(hit.actor);
+	result.rigidActor = hit.actor;
+	result.position = hit.position;
+	result.normal = hit.normal;
+	result.distance = hit.distance;
+	result.faceIndex = hit.faceIndex;
+	result.material = getHitMaterial(hit, hit.shape);
+	result.initialOverlap = hit.hadInitialOverlap();
 }
 
 void openps::physics::initialize() noexcept
 {
 	allocator.initialize(MB(256U));
 
+	frameArena.initialize(MB(1U), GB(1U));
+
+	destroyFrameContainers();
+	constructFrameContainers(&frameResource);
+
 	foundation = PxCreateFoundation(PX_PHYSICS_VERSION, allocatorCallback, errorReporter);
 
 	if (!foundation)
@@ -268,6 +1160,8 @@ void openps::physics::initialize() noexcept
 		return;
 	}
 
+	foundation->setReportAllocationNames(allocatorCallback.pool.getTrackTypes());
+
 	pvd = PxCreatePvd(*foundation);
 
 	if (!pvd)
@@ -313,6 +1207,9 @@ void openps::physics::initialize() noexcept
 		return;
 	}
 
+	if (nbQueryThreads)
+		queryDispatcher = PxDefaultCpuDispatcherCreate(nbQueryThreads);
+
 	PxCudaContextManagerDesc cudaContextManagerDesc;
 
 	cudaContextManager = PxCreateCudaContextManager(*foundation, cudaContextManagerDesc, &profilerCallback);
@@ -327,6 +1224,8 @@ void openps::physics::initialize() noexcept
 	sceneDesc.gravity = gravity;
 	sceneDesc.cpuDispatcher = dispatcher;
 	sceneDesc.filterShader = contactReportFilterShader;
+	sceneDesc.filterShaderData = &collisionMatrix;
+	sceneDesc.filterShaderDataSize = sizeof(collision_matrix);
 	//sceneDesc.kineKineFilteringMode = physx::PxPairFilteringMode::eKEEP;
 	//sceneDesc.staticKineFilteringMode = physx::PxPairFilteringMode::eKEEP;
 	sceneDesc.simulationEventCallback = &simulationCallback;
@@ -355,6 +1254,12 @@ void openps::physics::initialize() noexcept
 
 	sceneDesc.filterCallback = &simulationFilterCallback;
 
+	if (sceneQueryAdapter.isEnabled())
+	{
+		sceneQuerySystem = sceneQueryAdapter.create(useTreeOfPruners);
+		sceneDesc.sceneQuerySystem = sceneQuerySystem;
+	}
+
 	scene = physicsImpl->createScene(sceneDesc);
 
 	if (!scene)
@@ -363,7 +1268,7 @@ void openps::physics::initialize() noexcept
 		return;
 	}
 
-	defaultMaterial = physicsImpl->createMaterial(0.6f, 0.6f, 0.8f);
+	defaultMaterial = materials.createNamedMaterial("default", material_desc{ 0.6f, 0.6f, 0.8f });
 
 	if (!defaultMaterial)
 	{
@@ -390,14 +1295,27 @@ void openps::physics::release() noexcept
 {
 	PxCloseExtensions();
 
+	shapes.release();
+
+	materials.release();
+	defaultMaterial = nullptr;
+
+	// Everything created from the foundation has to go before it
+	PX_RELEASE(scene)
+	PX_RELEASE(sceneQuerySystem)
+	PX_RELEASE(dispatcher)
+	PX_RELEASE(queryDispatcher)
 	PX_RELEASE(physicsImpl)
+	PX_RELEASE(cudaContextManager)
 	PX_RELEASE(pvd)
 	PX_RELEASE(foundation)
-	PX_RELEASE(scene)
-	PX_RELEASE(defaultMaterial)
-	PX_RELEASE(cudaContextManager)
 
 	allocator.reset(true);
+
+	destroyFrameContainers();
+	constructFrameContainers(std::pmr::get_default_resource());
+
+	frameArena.reset(true);
 }
 
 void openps::physics::processSimulationEventCallbacks() noexcept
@@ -409,15 +1327,29 @@ void openps::physics::processSimulationEventCallbacks() noexcept
 
 void openps::physics::clearInternalQueues() noexcept
 {
-	while (collisionQueue.size())
-		collisionQueue.pop();
+	destroyFrameContainers();
+
+	frameArena.reset();
+
+	constructFrameContainers(&frameResource);
+}
+
+void openps::physics::destroyFrameContainers() noexcept
+{
+	std::destroy_at(&collisionQueue);
+	std::destroy_at(&collisionExitQueue);
+	std::destroy_at(&triggerQueue);
+	std::destroy_at(&triggerExitQueue);
 
-	while (collisionExitQueue.size())
-		collisionExitQueue.pop();
+	simulationCallback.rebuild(std::pmr::null_memory_resource());
+}
 
-	while (triggerQueue.size())
-		triggerQueue.pop();
+void openps::physics::constructFrameContainers(std::pmr::memory_resource* resource) noexcept
+{
+	std::construct_at(&collisionQueue, resource);
+	std::construct_at(&collisionExitQueue, resource);
+	std::construct_at(&triggerQueue, resource);
+	std::construct_at(&triggerExitQueue, resource);
 
-	while (triggerExitQueue.size())
-		triggerExitQueue.pop();
+	simulationCallback.rebuild(resource);
 }
\ No newline at end of file
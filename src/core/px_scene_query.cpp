@@ -0,0 +1,66 @@
+#include <core/px_scene_query.h>
+#include <core/px_logger.h>
+
+NODISCARD physx::PxCustomSceneQuerySystem* openps::layer_pruner_adapter::create(bool usesTreeOfPruners) noexcept
+{
+	PxCustomSceneQuerySystem* system = PxCreateCustomSceneQuerySystem(PxSceneQueryUpdateMode::eBUILD_ENABLED_COMMIT_ENABLED, 0, *this, usesTreeOfPruners);
+
+	if (!system)
+	{
+		logger::log_error("Physics> Failed to create PxCustomSceneQuerySystem.");
+		return nullptr;
+	}
+
+	auto addPruner = [&](PxPruningStructureType::Enum structure, uint32_t preallocated, const pruner& info)
+		{
+			const PxU32 index = system->addPruner(structure, PxDynamicTreeSecondaryPruner::eINCREMENTAL, preallocated);
+
+			if (index >= pruners.size())
+				pruners.resize(index + 1);
+
+			pruners[index] = info;
+			return index;
+		};
+
+	pruners.clear();
+
+	for (const layer_group_desc& group : groups)
+		addPruner(group.structure, group.preallocated, pruner{ group.layerMask, group.dynamic, false });
+
+	staticFallback = addPruner(PxPruningStructureType::eDYNAMIC_AABB_TREE, 0, pruner{ PX_LAYER_MASK_ALL, false, true });
+	dynamicFallback = addPruner(PxPruningStructureType::eDYNAMIC_AABB_TREE, 0, pruner{ PX_LAYER_MASK_ALL, true, true });
+
+	return system;
+}
+
+physx::PxU32 openps::layer_pruner_adapter::getPrunerIndex(const PxRigidActor& actor, const PxShape& shape) const
+{
+	const bool dynamic = actor.getType() != PxActorType::eRIGID_STATIC;
+	const uint32_t layerBits = shape.getQueryFilterData().word0;
+
+	// Shapes without a layer match every query
+	if (layerBits)
+	{
+		for (PxU32 i = 0; i < (PxU32)pruners.size(); ++i)
+		{
+			const pruner& info = pruners[i];
+			if (!info.fallback && info.dynamic == dynamic && (info.layerMask & layerBits))
+				return i;
+		}
+	}
+
+	return dynamic ? dynamicFallback : staticFallback;
+}
+
+bool openps::layer_pruner_adapter::processPruner(PxU32 prunerIndex, const PxQueryThreadContext* context, const PxQueryFilterData& filterData, PxQueryFilterCallback* filterCall) const
+{
+	UNUSED(context);
+	UNUSED(filterCall);
+
+	const pruner& info = pruners[prunerIndex];
+
+	if (!(filterData.flags & (info.dynamic ? PxQueryFlag::eDYNAMIC : PxQueryFlag::eSTATIC)))
+		return false;
+
+	return info.fallback || (info.layerMask & filterData.data.word0) != 0;
+}
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include <core/px_shapes.h>
+#include <core/px_physics.h>
+
+// Keys are compared bytewise, so -0 and 0 as well as NaNs with different payloads have to map to one bit pattern
+static float canonicalFloat(float value) noexcept
+{
+	if (value == 0.0f)
+		return 0.0f;
+
+	if (value != value)
+		return std::numeric_limits<float>::quiet_NaN();
+
+	return value;
+}
+
+static void storeMeshScale(float* params, const physx::PxMeshScale& scale) noexcept
+{
+	params[0] = scale.scale.x;
+	params[1] = scale.scale.y;
+	params[2] = scale.scale.z;
+	params[3] = scale.rotation.x;
+	params[4] = scale.rotation.y;
+	params[5] = scale.rotation.z;
+	params[6] = scale.rotation.w;
+}
+
+static void storeFilterData(uint32_t* words, const physx::PxFilterData& filterData) noexcept
+{
+	words[0] = filterData.word0;
+	words[1] = filterData.word1;
+	words[2] = filterData.word2;
+	words[3] = filterData.word3;
+}
+
+static openps::shape_key makeShapeKey(const physx::PxGeometry& geometry, const physx::PxMaterial& material,
+	const physx::PxFilterData& simulationFilterData, const physx::PxFilterData& queryFilterData, const physx::PxTransform& localPose,
+	physx::PxShapeFlags shapeFlags) noexcept
+{
+	using namespace physx;
+
+	openps::shape_key key;
+	key.geometryType = (uint32_t)geometry.getType();
+	key.shapeFlags = (uint32_t)shapeFlags;
+	key.material = &material;
+
+	storeFilterData(key.simulationFilterData, simulationFilterData);
+	storeFilterData(key.queryFilterData, queryFilterData);
+
+	key.localPose[0] = localPose.p.x;
+	key.localPose[1] = localPose.p.y;
+	key.localPose[2] = localPose.p.z;
+	key.localPose[3] = localPose.q.x;
+	key.localPose[4] = localPose.q.y;
+	key.localPose[5] = localPose.q.z;
+	key.localPose[6] = localPose.q.w;
+
+	switch (geometry.getType())
+	{
+	case PxGeometryType::eSPHERE:
+		key.params[0] = static_cast<const PxSphereGeometry&>(geometry).radius;
+		break;
+	case PxGeometryType::eCAPSULE:
+		key.params[0] = static_cast<const PxCapsuleGeometry&>(geometry).radius;
+		key.params[1] = static_cast<const PxCapsuleGeometry&>(geometry).halfHeight;
+		break;
+	case PxGeometryType::eBOX:
+	{
+		const PxVec3& halfExtents = static_cast<const PxBoxGeometry&>(geometry).halfExtents;
+		key.params[0] = halfExtents.x;
+		key.params[1] = halfExtents.y;
+		key.params[2] = halfExtents.z;
+		break;
+	}
+	case PxGeometryType::eCONVEXMESH:
+	{
+		const PxConvexMeshGeometry& convex = static_cast<const PxConvexMeshGeometry&>(geometry);
+		key.mesh = convex.convexMesh;
+		storeMeshScale(key.params, convex.scale);
+		key.params[7] = (float)(uint8_t)convex.meshFlags;
+		break;
+	}
+	case PxGeometryType::eTRIANGLEMESH:
+	{
+		const PxTriangleMeshGeometry& mesh = static_cast<const PxTriangleMeshGeometry&>(geometry);
+		key.mesh = mesh.triangleMesh;
+		storeMeshScale(key.params, mesh.scale);
+		key.params[7] = (float)(uint8_t)mesh.meshFlags;
+		break;
+	}
+	case PxGeometryType::eHEIGHTFIELD:
+	{
+		const PxHeightFieldGeometry& heightField = static_cast<const PxHeightFieldGeometry&>(geometry);
+		key.mesh = heightField.heightField;
+		key.params[0] = heightField.heightScale;
+		key.params[1] = heightField.rowScale;
+		key.params[2] = heightField.columnScale;
+		key.params[3] = (float)(uint8_t)heightField.heightFieldFlags;
+		break;
+	}
+	default:
+		break;
+	}
+
+	for (float& param : key.params)
+		param = canonicalFloat(param);
+
+	for (float& value : key.localPose)
+		value = canonicalFloat(value);
+
+	return key;
+}
+
+NODISCARD size_t openps::shape_key_hash::operator()(const shape_key& key) const noexcept
+{
+	// FNV-1a over the whole key, shape_key has no padding
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&key);
+
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(shape_key); ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return (size_t)hash;
+}
+
+NODISCARD physx::PxShape* openps::shape_cache::acquire(const PxGeometry& geometry, PxMaterial& material,
+	const PxFilterData& simulationFilterData, const PxFilterData& queryFilterData, const PxTransform& localPose, PxShapeFlags shapeFlags) noexcept
+{
+	const shape_key key = makeShapeKey(geometry, material, simulationFilterData, queryFilterData, localPose, shapeFlags);
+
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	auto iter = shapes.find(key);
+	if (iter != shapes.end())
+	{
+		++iter->second.refCount;
+		return iter->second.shape;
+	}
+
+	PxShape* shape = physics_holder::physicsRef->getPhysicsImpl()->createShape(geometry, material, false, shapeFlags);
+
+	if (!shape)
+	{
+		logger::log_error("Physics> Failed to create PxShape.");
+		return nullptr;
+	}
+
+	shape->setSimulationFilterData(simulationFilterData);
+	shape->setQueryFilterData(queryFilterData);
+	shape->setLocalPose(localPose);
+
+	shapes.emplace(key, shape_entry{ shape, 1 });
+	shapeKeys.emplace(shape, key);
+
+	return shape;
+}
+
+void openps::shape_cache::erase(std::unordered_map<shape_key, shape_entry, shape_key_hash>::iterator iter) noexcept
+{
+	// Actors still holding the shape keep it alive, only the cache's reference goes away
+	shapeKeys.erase(iter->second.shape);
+	iter->second.shape->release();
+	shapes.erase(iter);
+}
+
+void openps::shape_cache::release(PxShape* shape) noexcept
+{
+	if (!shape)
+		return;
+
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	auto keyIter = shapeKeys.find(shape);
+	if (keyIter == shapeKeys.end())
+		return;
+
+	auto iter = shapes.find(keyIter->second);
+	if (--iter->second.refCount == 0)
+		erase(iter);
+}
+
+void openps::shape_cache::trim() noexcept
+{
+	bool released = false;
+
+	{
+		::std::unique_lock<::std::mutex> lock{ mutex };
+
+		for (auto iter = shapes.begin(); iter != shapes.end();)
+		{
+			auto next = std::next(iter);
+
+			if (iter->second.shape->getReferenceCount() == 1)
+			{
+				erase(iter);
+				released = true;
+			}
+
+			iter = next;
+		}
+	}
+
+	// A query_cache may still point at one of the released shapes
+	if (released)
+		physics_holder::physicsRef->invalidateQueryCaches();
+}
+
+void openps::shape_cache::release() noexcept
+{
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	for (auto& [key, entry] : shapes)
+		PX_RELEASE(entry.shape)
+
+	shapes.clear();
+	shapeKeys.clear();
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include <core/px_static_world.h>
+
+#include <extensions/PxCollectionExt.h>
+
+void openps::static_world::buildAsync(std::vector<PxRigidActor*> newActors) noexcept
+{
+	release();
+
+	actors = std::move(newActors);
+
+	buildTask = std::async(std::launch::async, [this]()
+		{
+			return physics_holder::physicsRef->getPhysicsImpl()->createPruningStructure(actors.data(), (PxU32)actors.size());
+		});
+}
+
+NODISCARD bool openps::static_world::isReady() const noexcept
+{
+	if (pruningStructure)
+		return true;
+
+	return buildTask.valid() && buildTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool openps::static_world::insert() noexcept
+{
+	if (inScene)
+		return true;
+
+	if (!waitForBuild())
+		return false;
+
+	inScene = physics_holder::physicsRef->addActors(*pruningStructure);
+
+	return inScene;
+}
+
+bool openps::static_world::save(const char* path) noexcept
+{
+	if (!waitForBuild())
+		return false;
+
+	PxPhysics* physicsImpl = physics_holder::physicsRef->getPhysicsImpl();
+
+	PxSerializationRegistry* registry = PxSerialization::createSerializationRegistry(*physicsImpl);
+	PxCollection* saveCollection = PxCreateCollection();
+
+	saveCollection->add(*pruningStructure);
+	PxSerialization::complete(*saveCollection, *registry);
+	PxSerialization::createSerialObjectIds(*saveCollection, PxSerialObjectId(1));
+
+	PxDefaultFileOutputStream stream(path);
+
+	const bool result = stream.isValid() && PxSerialization::serializeCollectionToBinary(stream, *saveCollection, *registry);
+
+	if (!result)
+		logger::log_error("Physics> Failed to save static world.");
+
+	saveCollection->release();
+	registry->release();
+
+	return result;
+}
+
+bool openps::static_world::load(const char* path) noexcept
+{
+	release();
+
+	PxDefaultFileInputData stream(path);
+
+	if (!stream.isValid())
+	{
+		logger::log_error("Physics> Failed to open static world file.");
+		return false;
+	}
+
+	const PxU32 length = stream.getLength();
+
+	// Deserialized objects live inside this block, so it's kept until release()
+	serializedMemory = std::make_unique<uint8_t[]>(length + PX_SERIAL_FILE_ALIGN);
+	void* alignedMemory = alignTo(serializedMemory.get(), PX_SERIAL_FILE_ALIGN);
+	stream.read(alignedMemory, length);
+
+	serializationRegistry = PxSerialization::createSerializationRegistry(*physics_holder::physicsRef->getPhysicsImpl());
+	collection = PxSerialization::createCollectionFromBinary(alignedMemory, *serializationRegistry);
+
+	if (!collection)
+	{
+		logger::log_error("Physics> Failed to deserialize static world.");
+		release();
+		return false;
+	}
+
+	for (PxU32 i = 0; i < collection->getNbObjects(); ++i)
+	{
+		PxBase& object = collection->getObject(i);
+
+		// userData still points into the process which baked the file
+		if (PxRigidActor* actor = object.is<PxRigidActor>())
+		{
+			actor->userData = nullptr;
+			actors.push_back(actor);
+		}
+		else if (PxPruningStructure* structure = object.is<PxPruningStructure>())
+			pruningStructure = structure;
+	}
+
+	// The per-layer pruners can't take the baked structure, the actors are inserted one by one instead
+	if (pruningStructure && physics_holder::physicsRef->getSceneQuerySystem())
+	{
+		physics_holder::physicsRef->addActors(actors.data(), (uint32_t)actors.size());
+		inScene = true;
+	}
+	else
+		inScene = physics_holder::physicsRef->addCollection(*collection);
+
+	return inScene;
+}
+
+void openps::static_world::release() noexcept
+{
+	if (buildTask.valid())
+		pruningStructure = buildTask.get();
+
+	if (inScene)
+	{
+		physics_holder::physicsRef->removeActors(actors.data(), (uint32_t)actors.size());
+		inScene = false;
+	}
+
+	if (!actors.empty())
+		physics_holder::physicsRef->unregisterActors(actors.data(), (uint32_t)actors.size());
+
+	if (collection)
+	{
+		PxCollectionExt::releaseObjects(*collection);
+		PX_RELEASE(collection)
+		pruningStructure = nullptr;
+	}
+	else
+	{
+		PX_RELEASE(pruningStructure)
+	}
+
+	PX_RELEASE(serializationRegistry)
+	serializedMemory.reset();
+
+	actors.clear();
+}
+
+bool openps::static_world::waitForBuild() noexcept
+{
+	if (buildTask.valid())
+		pruningStructure = buildTask.get();
+
+	if (!pruningStructure)
+	{
+		logger::log_error("Physics> Static world pruning structure is not built.");
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include <core/px_trigger_volumes.h>
+#include <core/px_tasks.h>
+#include <ecs/px_rigidbody.h>
+
+NODISCARD uint64_t openps::trigger_volumes::cellKey(int32_t x, int32_t y, int32_t z) const noexcept
+{
+	static constexpr uint64_t mask = (1ull << 21) - 1;
+	return ((uint64_t)x & mask) | (((uint64_t)y & mask) << 21) | (((uint64_t)z & mask) << 42);
+}
+
+uint32_t openps::trigger_volumes::addZone(const zone& newZone) noexcept
+{
+	uint32_t index;
+
+	if (!freeZones.empty())
+	{
+		index = freeZones.back();
+		freeZones.pop_back();
+		zones[index] = newZone;
+	}
+	else
+	{
+		index = (uint32_t)zones.size();
+		zones.push_back(newZone);
+	}
+
+	gridDirty = true;
+
+	return index;
+}
+
+uint32_t openps::trigger_volumes::addSphere(uint32_t handle, const PxVec3& center, float radius) noexcept
+{
+	zone newZone;
+	newZone.bounds = PxBounds3::centerExtents(center, PxVec3(radius));
+	newZone.center = center;
+	newZone.radius = radius;
+	newZone.handle = handle;
+	newZone.type = zone_type::Sphere;
+
+	return addZone(newZone);
+}
+
+uint32_t openps::trigger_volumes::addBox(uint32_t handle, const PxBounds3& bounds) noexcept
+{
+	zone newZone;
+	newZone.bounds = bounds;
+	newZone.center = bounds.getCenter();
+	newZone.handle = handle;
+	newZone.type = zone_type::Box;
+
+	return addZone(newZone);
+}
+
+void openps::trigger_volumes::removeZone(uint32_t index) noexcept
+{
+	// Bodies still inside get their exit event on the next update, the slot is reused only after that
+	zones[index].type = zone_type::None;
+	removedZones.push_back(index);
+	gridDirty = true;
+}
+
+void openps::trigger_volumes::addBody(const rigidbody* rb) noexcept
+{
+	bodies.emplace_back().rb = rb;
+}
+
+void openps::trigger_volumes::removeBody(const rigidbody* rb) noexcept
+{
+	auto iter = std::find_if(bodies.begin(), bodies.end(), [rb](const tracked_body& body) { return body.rb == rb; });
+	if (iter == bodies.end())
+		return;
+
+	*iter = std::move(bodies.back());
+	bodies.pop_back();
+}
+
+void openps::trigger_volumes::rebuild() noexcept
+{
+	grid.clear();
+
+	for (uint32_t i = 0; i < (uint32_t)zones.size(); ++i)
+	{
+		const zone& z = zones[i];
+
+		if (z.type == zone_type::None)
+			continue;
+
+		const int32_t minX = cellCoord(z.bounds.minimum.x), maxX = cellCoord(z.bounds.maximum.x);
+		const int32_t minY = cellCoord(z.bounds.minimum.y), maxY = cellCoord(z.bounds.maximum.y);
+		const int32_t minZ = cellCoord(z.bounds.minimum.z), maxZ = cellCoord(z.bounds.maximum.z);
+
+		for (int32_t x = minX; x <= maxX; ++x)
+			for (int32_t y = minY; y <= maxY; ++y)
+				for (int32_t cz = minZ; cz <= maxZ; ++cz)
+				{
+					grid_cell& cell = grid[cellKey(x, y, cz)];
+
+					if (z.type == zone_type::Sphere)
+					{
+						cell.sphereX.push_back(z.center.x);
+						cell.sphereY.push_back(z.center.y);
+						cell.sphereZ.push_back(z.center.z);
+						cell.sphereRadiusSq.push_back(z.radius * z.radius);
+						cell.spheres.push_back(i);
+					}
+					else
+					{
+						cell.boxMinX.push_back(z.bounds.minimum.x);
+						cell.boxMinY.push_back(z.bounds.minimum.y);
+						cell.boxMinZ.push_back(z.bounds.minimum.z);
+						cell.boxMaxX.push_back(z.bounds.maximum.x);
+						cell.boxMaxY.push_back(z.bounds.maximum.y);
+						cell.boxMaxZ.push_back(z.bounds.maximum.z);
+						cell.boxes.push_back(i);
+					}
+				}
+	}
+
+	for (auto& [key, cell] : grid)
+	{
+		while (cell.spheres.size() & 3)
+		{
+			cell.sphereX.push_back(0.0f);
+			cell.sphereY.push_back(0.0f);
+			cell.sphereZ.push_back(0.0f);
+			cell.sphereRadiusSq.push_back(-1.0f);
+			cell.spheres.push_back(0xFFFFFFFF);
+		}
+
+		while (cell.boxes.size() & 3)
+		{
+			cell.boxMinX.push_back(PX_MAX_F32);
+			cell.boxMinY.push_back(PX_MAX_F32);
+			cell.boxMinZ.push_back(PX_MAX_F32);
+			cell.boxMaxX.push_back(-PX_MAX_F32);
+			cell.boxMaxY.push_back(-PX_MAX_F32);
+			cell.boxMaxZ.push_back(-PX_MAX_F32);
+			cell.boxes.push_back(0xFFFFFFFF);
+		}
+	}
+
+	gridDirty = false;
+}
+
+void openps::trigger_volumes::testCell(const grid_cell& cell, const PxVec3& position, std::vector<uint32_t>& result) const noexcept
+{
+	const __m128 px = _mm_set1_ps(position.x);
+	const __m128 py = _mm_set1_ps(position.y);
+	const __m128 pz = _mm_set1_ps(position.z);
+
+	for (size_t i = 0; i < cell.spheres.size(); i += 4)
+	{
+		const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&cell.sphereX[i]), px);
+		const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&cell.sphereY[i]), py);
+		const __m128 dz = _mm_sub_ps(_mm_loadu_ps(&cell.sphereZ[i]), pz);
+
+		const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		int mask = _mm_movemask_ps(_mm_cmple_ps(distSq, _mm_loadu_ps(&cell.sphereRadiusSq[i])));
+
+		while (mask)
+		{
+			const uint32_t lane = PxLowestSetBit((uint32_t)mask);
+			result.push_back(cell.spheres[i + lane]);
+			mask &= mask - 1;
+		}
+	}
+
+	for (size_t i = 0; i < cell.boxes.size(); i += 4)
+	{
+		__m128 inside = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&cell.boxMinX[i]), px), _mm_cmple_ps(px, _mm_loadu_ps(&cell.boxMaxX[i])));
+		inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&cell.boxMinY[i]), py), _mm_cmple_ps(py, _mm_loadu_ps(&cell.boxMaxY[i]))));
+		inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&cell.boxMinZ[i]), pz), _mm_cmple_ps(pz, _mm_loadu_ps(&cell.boxMaxZ[i]))));
+
+		int mask = _mm_movemask_ps(inside);
+
+		while (mask)
+		{
+			const uint32_t lane = PxLowestSetBit((uint32_t)mask);
+			result.push_back(cell.boxes[i + lane]);
+			mask &= mask - 1;
+		}
+	}
+}
+
+void openps::trigger_volumes::update() noexcept
+{
+	// Same lifetime as the physics queues, events are valid until the next update
+	triggerQueue = {};
+	triggerExitQueue = {};
+
+	if (gridDirty)
+		rebuild();
+
+	auto physics = physics_holder::physicsRef;
+
+	parallelFor(physics->getQueryDispatcher(), (uint32_t)bodies.size(), PX_QUERY_BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+		{
+			physics_lock_read lock{};
+
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				tracked_body& body = bodies[i];
+				body.current.clear();
+
+				const PxRigidActor* actor = body.rb->getRigidActor();
+				if (!actor)
+					continue;
+
+				const PxVec3 position = actor->getGlobalPose().p;
+
+				auto iter = grid.find(cellKey(cellCoord(position.x), cellCoord(position.y), cellCoord(position.z)));
+				if (iter == grid.end())
+					continue;
+
+				testCell(iter->second, position, body.current);
+				std::sort(body.current.begin(), body.current.end());
+			}
+		});
+
+	// Diffed serially so the event order doesn't depend on the thread split
+	for (tracked_body& body : bodies)
+	{
+		const uint32_t bodyHandle = body.rb->handle;
+
+		auto previous = body.inside.begin();
+		auto current = body.current.begin();
+
+		while (previous != body.inside.end() || current != body.current.end())
+		{
+			if (current == body.current.end() || (previous != body.inside.end() && *previous < *current))
+			{
+				triggerExitQueue.emplace(bodyHandle, zones[*previous].handle);
+				++previous;
+			}
+			else if (previous == body.inside.end() || *current < *previous)
+			{
+				triggerQueue.emplace(bodyHandle, zones[*current].handle);
+				++current;
+			}
+			else
+			{
+				++previous;
+				++current;
+			}
+		}
+
+		std::swap(body.inside, body.current);
+	}
+
+	freeZones.insert(freeZones.end(), removedZones.begin(), removedZones.end());
+	removedZones.clear();
+}
\ No newline at end of file
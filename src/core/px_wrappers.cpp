@@ -2,19 +2,19 @@
 #include <core/px_physics.h>
 
 static void clearColliderFromCollection(const openps::rigidbody* collider,
-	physx::PxArray<openps::simulation_event_callback::colliders_pair>& collection) noexcept
+	std::pmr::vector<openps::simulation_event_callback::colliders_pair>& collection) noexcept
 {
-	const auto c = &collection[0];
-	for (uint32_t i = 0; i < collection.size(); ++i)
-	{
-		const openps::simulation_event_callback::colliders_pair cc = c[i];
-		if (cc.first == collider || cc.second == collider)
+	std::erase_if(collection, [collider](const openps::simulation_event_callback::colliders_pair& cc)
 		{
-			collection.remove(i--);
-			if (collection.empty())
-				break;
-		}
-	}
+			return cc.first == collider || cc.second == collider;
+		});
+}
+
+template <typename T>
+static void rebuildArray(std::pmr::vector<T>& array, std::pmr::memory_resource* resource) noexcept
+{
+	std::destroy_at(&array);
+	std::construct_at(&array, resource);
 }
 
 void openps::simulation_event_callback::clear() noexcept
@@ -27,6 +27,16 @@ void openps::simulation_event_callback::clear() noexcept
 	lostTriggerPairs.clear();
 }
 
+void openps::simulation_event_callback::rebuild(std::pmr::memory_resource* resource) noexcept
+{
+	rebuildArray(newCollisions, resource);
+	rebuildArray(removedCollisions, resource);
+	rebuildArray(kinematicsToRemoveFlag, resource);
+
+	rebuildArray(newTriggerPairs, resource);
+	rebuildArray(lostTriggerPairs, resource);
+}
+
 void openps::simulation_event_callback::sendCollisionEvents()
 {
 	for (auto& c : removedCollisions)
@@ -136,7 +146,7 @@ void openps::simulation_event_callback::onContact(const PxContactPairHeader& pai
 
 			if (cp.flags & PxContactPairFlag::eACTOR_PAIR_HAS_FIRST_TOUCH)
 			{
-				newCollisions.pushBack(collision);
+				newCollisions.push_back(collision);
 			}
 		}
 		else if (cp.events & physx::PxPairFlag::eNOTIFY_TOUCH_LOST)
@@ -161,7 +171,7 @@ void openps::simulation_event_callback::onContact(const PxContactPairHeader& pai
 
 			if (cp.flags & PxContactPairFlag::eACTOR_PAIR_LOST_TOUCH)
 			{
-				removedCollisions.pushBack(collision);
+				removedCollisions.push_back(collision);
 			}
 		}
 	}
@@ -190,58 +200,138 @@ physx::PxTriangleMesh* openps::createTriangleMesh(PxTriangleMeshDesc desc)
 	return nullptr;
 }
 
-physx::PxRigidActor* openps::createRigidbodyActor(rigidbody* rb, collider_base* collider, const PxTransform& trs) noexcept
+static bool attachColliderShapes(const openps::rigidbody* rb, physx::PxRigidActor* actor, openps::collider_base* collider, physx::PxMaterial* material) noexcept
 {
-	if (!rb || !collider)
-		return nullptr;
+	using namespace physx;
 
-	const auto physics = openps::physics_holder::physicsRef->getPhysicsImpl();
+	auto& shapeCache = openps::physics_holder::physicsRef->getShapeCache();
 
-	rb->material = physics->createMaterial(rb->staticFriction, rb->dynamicFriction, rb->restitution);
+	const PxFilterData simulationFilterData = rb->getSimulationFilterData();
+	const PxFilterData queryFilterData = rb->getQueryFilterData();
 
-	if (rb->type == rigidbody_type::Static)
+	if (collider->getType() != openps::collider_type::Compound)
 	{
-		PxRigidStatic* actor = physics->createRigidStatic(trs);
+		PxGeometry* geometry = collider->createGeometry();
 
-		PxShape* shape = PxRigidActorExt::createExclusiveShape(*actor, *collider->createGeometry(), *rb->material);
+		if (!geometry)
+		{
+			openps::logger::log_error("Physics> Collider has no geometry.");
+			return false;
+		}
 
-		uint32_t* h = new uint32_t[1];
-		h[0] = (uint32_t)rb->handle;
+		PxShape* shape = shapeCache.acquire(*geometry, *material, simulationFilterData, queryFilterData);
 
-		actor->userData = h;
-		shape->userData = h;
+		if (shape && !actor->attachShape(*shape))
+		{
+			shapeCache.release(shape);
+			return false;
+		}
 
-		rb->actor = actor;
+		return shape != nullptr;
+	}
 
-		openps::physics_holder::physicsRef->addActor(rb, rb->actor);
+	const auto compound = static_cast<openps::compound_collider*>(collider);
 
-		return actor;
+	if (compound->children.empty())
+	{
+		openps::logger::log_error("Physics> Compound collider has no children.");
+		return false;
 	}
-	else
+
+	for (const auto& child : compound->children)
 	{
-		PxRigidDynamic* actor = physics->createRigidDynamic(trs);
-		actor->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_POSE_INTEGRATION_PREVIEW, true);
-		actor->setRigidBodyFlag(PxRigidBodyFlag::eRETAIN_ACCELERATIONS, true);
-		actor->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_CCD, true);
-		actor->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_SPECULATIVE_CCD, true);
-		actor->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_CCD_FRICTION, true);
+		PxGeometry* geometry = child.collider && child.collider->getType() != openps::collider_type::Compound
+			? child.collider->createGeometry()
+			: nullptr;
 
-		PxShape* shape = PxRigidActorExt::createExclusiveShape(*actor, *collider->createGeometry(), *rb->material);
+		if (!geometry)
+		{
+			openps::logger::log_error("Physics> Compound collider child has no geometry.");
+			return false;
+		}
 
-		uint32_t* h = new uint32_t[1];
-		h[0] = (uint32_t)rb->handle;
+		PxShape* shape = shapeCache.acquire(*geometry, child.material ? *child.material : *material,
+			simulationFilterData, queryFilterData, child.localPose);
 
-		actor->userData = h;
-		shape->userData = h;
+		if (!shape)
+			return false;
 
-		rb->actor = actor;
+		if (!actor->attachShape(*shape))
+		{
+			shapeCache.release(shape);
+			return false;
+		}
+	}
 
-		openps::physics_holder::physicsRef->addActor(rb, rb->actor);
+	if (PxRigidBody* body = actor->is<PxRigidBody>())
+	{
+		std::vector<PxReal> densities;
+		densities.reserve(compound->children.size());
+
+		for (const auto& child : compound->children)
+			densities.push_back(child.density);
 
-		return actor;
+		PxRigidBodyExt::updateMassAndInertia(*body, densities.data(), (PxU32)densities.size());
 	}
 
-	return nullptr;
+	return true;
+}
+
+physx::PxRigidActor* openps::createRigidbodyActor(rigidbody* rb, collider_base* collider, const PxTransform& trs, bool addToScene) noexcept
+{
+	if (!rb || !collider)
+		return nullptr;
+
+	const auto physics = openps::physics_holder::physicsRef->getPhysicsImpl();
+
+	auto& materials = openps::physics_holder::physicsRef->getMaterialRegistry();
+
+	if (rb->material)
+		rb->material = materials.acquire(rb->material);
+	else
+		rb->material = materials.acquire(material_desc{ rb->staticFriction, rb->dynamicFriction, rb->restitution });
+
+	if (!rb->material)
+		return nullptr;
+
+	PxRigidActor* actor = nullptr;
+
+	if (rb->type == rigidbody_type::Static)
+	{
+		actor = physics->createRigidStatic(trs);
+	}
+	else
+	{
+		PxRigidDynamic* dynamic = physics->createRigidDynamic(trs);
+		dynamic->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_POSE_INTEGRATION_PREVIEW, true);
+		dynamic->setRigidBodyFlag(PxRigidBodyFlag::eRETAIN_ACCELERATIONS, true);
+		dynamic->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_CCD, true);
+		dynamic->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_SPECULATIVE_CCD, true);
+		dynamic->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_CCD_FRICTION, true);
+
+		actor = dynamic;
+	}
+
+	if (!attachColliderShapes(rb, actor, collider, rb->material))
+	{
+		// Compound children attached before the failing one still hold cache references
+		openps::physics_holder::physicsRef->releaseCachedShapes(actor);
+		PX_RELEASE(actor)
+		materials.release(rb->material);
+		rb->material = nullptr;
+		return nullptr;
+	}
+
+	if (PxRigidBody* body = actor->is<PxRigidBody>())
+		rb->mass = body->getMass();
+
+	actor->userData = &rb->handle;
+
+	rb->actor = actor;
+
+	openps::physics_holder::physicsRef->addActor(rb, rb->actor, addToScene);
+
+	return actor;
 }
 
 void openps::collision::swapObjects() noexcept
@@ -266,11 +356,12 @@ void openps::error_reporter::reportError(PxErrorCode::Enum code, const char* mes
 
 physx::PxQueryHitType::Enum openps::query_filter::preFilter(const PxFilterData& filterData, const PxShape* shape, const PxRigidActor* actor, PxHitFlags& queryFlags)
 {
-	if (!shape)
+	if (!shape || actor == ignoreActor)
 		return PxQueryHitType::eNONE;
 
+	// Shapes without query filter data belong to every layer
 	const PxFilterData shapeFilter = shape->getQueryFilterData();
-	if ((filterData.word0 & shapeFilter.word0) == 0)
+	if (shapeFilter.word0 && (filterData.word0 & shapeFilter.word0) == 0)
 		return PxQueryHitType::eNONE;
 
 	const bool hitTriggers = filterData.word2 != 0;
@@ -289,10 +380,10 @@ physx::PxQueryHitType::Enum openps::query_filter::postFilter(const PxFilterData&
 void* openps::allocator_callback::allocate(size_t size, const char* typeName, const char* filename, int line)
 {
 	ASSERT(size < GB(1));
-	return _aligned_malloc(size, 16);
+	return pool.allocate(size, typeName);
 }
 
 void openps::allocator_callback::deallocate(void* ptr)
 {
-	_aligned_free(ptr);
+	pool.deallocate(ptr);
 }
\ No newline at end of file
@@ -3,7 +3,7 @@
 
 namespace openps
 {
-	static NODISCARD openps::bounding_box calculateBoundingBox(const std::vector<physx::PxVec3>& positions) noexcept
+	NODISCARD static openps::bounding_box calculateBoundingBox(const std::vector<physx::PxVec3>& positions) noexcept
 	{
 		openps::bounding_box box;
 		if (positions.empty())
@@ -93,30 +93,30 @@ namespace openps
 
 	PxGeometry* box_collider::createGeometry()
 	{
-		geometry = new PxBoxGeometry(x, y, z);
+		geometry.storeAny(PxBoxGeometry(x, y, z));
 
-		return geometry;
+		return &geometry.any();
 	}
 
 	PxGeometry* sphere_collider::createGeometry()
 	{
-		geometry = new PxSphereGeometry(radius);
+		geometry.storeAny(PxSphereGeometry(radius));
 
-		return geometry;
+		return &geometry.any();
 	}
 
 	PxGeometry* capsule_collider::createGeometry()
 	{
-		geometry = new PxCapsuleGeometry(radius, height / 2.0f);
+		geometry.storeAny(PxCapsuleGeometry(radius, height / 2.0f));
 
-		return geometry;
+		return &geometry.any();
 	}
 
 	PxGeometry* plane_collider::createGeometry()
 	{
-		geometry = new PxPlaneGeometry();
+		geometry.storeAny(PxPlaneGeometry());
 
-		return geometry;
+		return &geometry.any();
 	}
 
 	bool plane_collider::createShape()
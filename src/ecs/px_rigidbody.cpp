@@ -47,6 +47,88 @@ void openps::rigidbody::setMass(float newMass) noexcept
 	}
 }
 
+void openps::rigidbody::setMaterial(PxMaterial* newMaterial) noexcept
+{
+	if (actor)
+	{
+		logger::log_error("Physics> Material can't be changed after the actor has been created.");
+		return;
+	}
+
+	material = newMaterial;
+}
+
+void openps::rigidbody::setLayer(uint8_t newLayer) noexcept
+{
+	ASSERT(newLayer < PX_NB_COLLISION_LAYERS);
+	layer = newLayer;
+	updateFilterData();
+}
+
+void openps::rigidbody::setFilterMask(PxU32 newMask) noexcept
+{
+	filterMask = newMask;
+	updateFilterData();
+}
+
+void openps::rigidbody::updateFilterData() noexcept
+{
+	if (!actor)
+		return;
+
+	physics_lock_write lock{};
+
+	const PxFilterData simulationFilterData = getSimulationFilterData();
+	const PxFilterData queryFilterData = getQueryFilterData();
+
+	auto& shapeCache = physics_holder::physicsRef->getShapeCache();
+
+	const uint32_t nbShapes = actor->getNbShapes();
+
+	std::vector<PxShape*> shapes(nbShapes);
+	actor->getShapes(shapes.data(), nbShapes);
+
+	for (PxShape* shape : shapes)
+	{
+		if (shape->isExclusive())
+		{
+			// Reattached so a per-layer scene query system moves the shape to its new pruner
+			shape->acquireReference();
+			actor->detachShape(*shape);
+			shape->setSimulationFilterData(simulationFilterData);
+			shape->setQueryFilterData(queryFilterData);
+			actor->attachShape(*shape);
+			shape->release();
+			continue;
+		}
+
+		// Shared shapes can't be modified per actor, swap them with a cached shape carrying the new filter data
+		PxMaterial* shapeMaterial = nullptr;
+		shape->getMaterials(&shapeMaterial, 1);
+
+		PxShape* newShape = shapeCache.acquire(shape->getGeometry(), *shapeMaterial, simulationFilterData, queryFilterData,
+			shape->getLocalPose(), shape->getFlags());
+
+		if (!newShape)
+			continue;
+
+		if (newShape == shape)
+		{
+			shapeCache.release(newShape);
+			continue;
+		}
+
+		actor->detachShape(*shape);
+		actor->attachShape(*newShape);
+		shapeCache.release(shape);
+	}
+
+	physics_holder::physicsRef->invalidateQueryCaches();
+
+	if (PxScene* scene = actor->getScene())
+		scene->resetFiltering(*actor);
+}
+
 void openps::rigidbody::onCollisionExit(rigidbody* collision) const noexcept
 {
 	openps::logger::log_message("collision exit");
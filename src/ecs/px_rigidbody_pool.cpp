@@ -0,0 +1,98 @@
+#include <ecs/px_rigidbody_pool.h>
+#include <core/px_physics.h>
+
+openps::rigidbody_pool::rigidbody_pool(const rigidbody& prototype, collider_base* collider, uint32_t capacity, const PxTransform& parkingPose) noexcept
+	: parkingPose(parkingPose)
+{
+	if (prototype.getRigidActor() || prototype.getType() != rigidbody_type::Dynamic)
+	{
+		logger::log_error("Physics> Rigidbody pool prototype must be a dynamic rigidbody without an actor.");
+		return;
+	}
+
+	bodies.reserve(capacity);
+	freeIndices.reserve(capacity);
+
+	for (uint32_t i = 0; i < capacity; ++i)
+	{
+		rigidbody& rb = bodies.emplace_back(prototype);
+
+		if (!createRigidbodyActor(&rb, collider, parkingPose, false))
+		{
+			bodies.pop_back();
+			logger::log_error("Physics> Failed to create pooled rigidbody actor.");
+			break;
+		}
+	}
+
+	for (uint32_t i = (uint32_t)bodies.size(); i > 0; --i)
+		freeIndices.push_back(i - 1);
+}
+
+openps::rigidbody_pool::~rigidbody_pool()
+{
+	auto physics = physics_holder::physicsRef;
+
+	if (!physics)
+		return;
+
+	for (rigidbody& rb : bodies)
+	{
+		PxRigidActor* actor = rb.getRigidActor();
+		physics->removeActor(&rb);
+		PX_RELEASE(actor)
+	}
+}
+
+NODISCARD openps::rigidbody* openps::rigidbody_pool::acquire(uint32_t handle, const PxTransform& pose, const PxVec3& linearVelocity, const PxVec3& angularVelocity) noexcept
+{
+	rigidbody* rb = nullptr;
+
+	{
+		::std::unique_lock<::std::mutex> lock{ mutex };
+
+		if (freeIndices.empty())
+			return nullptr;
+
+		rb = &bodies[freeIndices.back()];
+		freeIndices.pop_back();
+	}
+
+	rb->handle = handle;
+
+	physics_lock_write lock{};
+
+	PxRigidDynamic* actor = rb->getRigidActor()->is<PxRigidDynamic>();
+	actor->setGlobalPose(pose);
+	actor->setLinearVelocity(linearVelocity);
+	actor->setAngularVelocity(angularVelocity);
+
+	physics_holder::physicsRef->addActor(actor);
+
+	actor->wakeUp();
+
+	return rb;
+}
+
+void openps::rigidbody_pool::release(rigidbody* rb) noexcept
+{
+	if (!owns(rb))
+	{
+		logger::log_error("Physics> Rigidbody is not owned by this pool.");
+		return;
+	}
+
+	{
+		physics_lock_write lock{};
+
+		PxRigidDynamic* actor = rb->getRigidActor()->is<PxRigidDynamic>();
+		physics_holder::physicsRef->reomoveActor(actor);
+
+		actor->setLinearVelocity(PxVec3(0.0f));
+		actor->setAngularVelocity(PxVec3(0.0f));
+		actor->setGlobalPose(parkingPose);
+	}
+
+	::std::unique_lock<::std::mutex> lock{ mutex };
+	freeIndices.push_back((uint32_t)(rb - bodies.data()));
+}
\ No newline at end of file
@@ -1,24 +1,199 @@
 #include <memory/ememory.h>
 
-void openps::eallocator::initialize(uint64_t minimumBlockSize, uint64_t reserveSize) noexcept
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static constexpr uint64_t hugePageSize = MB(2);
+
+static uint8_t* reservePages(uint64_t size, openps::page_mode& pages) noexcept
 {
-	reset(true);
+#if defined(_WIN32)
+	// Large pages need SeLockMemoryPrivilege and can't be committed lazily
+	pages = openps::page_mode::Default;
+	return (uint8_t*)VirtualAlloc(0, size, MEM_RESERVE, PAGE_READWRITE);
+#else
+	void* result = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+	if (pages == openps::page_mode::ExplicitHuge)
+	{
+		// Without MAP_NORESERVE the whole range is reserved from the pool up front, so an empty pool fails here
+		// instead of raising SIGBUS on first touch
+		result = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (result == MAP_FAILED)
+			pages = openps::page_mode::Default;
+	}
+#else
+	pages = openps::page_mode::Default;
+#endif
+
+	if (result == MAP_FAILED)
+		result = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (result == MAP_FAILED)
+		return 0;
+
+#if defined(MADV_HUGEPAGE)
+	if (pages == openps::page_mode::TransparentHuge)
+		madvise(result, size, MADV_HUGEPAGE);
+#endif
+
+	return (uint8_t*)result;
+#endif
+}
+
+static bool commitPages(uint8_t* address, uint64_t size) noexcept
+{
+#if defined(_WIN32)
+	return VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != 0;
+#else
+	return mprotect(address, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
 
-	memory = (uint8_t*)VirtualAlloc(0, reserveSize, MEM_RESERVE, PAGE_READWRITE);
+static void decommitPages(uint8_t* address, uint64_t size) noexcept
+{
+#if defined(_WIN32)
+	VirtualFree(address, size, MEM_DECOMMIT);
+#else
+	madvise(address, size, MADV_DONTNEED);
+	mprotect(address, size, PROT_NONE);
+#endif
+}
+
+static void releasePages(uint8_t* address, uint64_t size) noexcept
+{
+#if defined(_WIN32)
+	UNUSED(size);
+	VirtualFree(address, 0, MEM_RELEASE);
+#else
+	munmap(address, size);
+#endif
+}
 
+static uint64_t systemPageSize() noexcept
+{
+#if defined(_WIN32)
 	SYSTEM_INFO systemInfo;
 	GetSystemInfo(&systemInfo);
+	return systemInfo.dwPageSize;
+#else
+	return (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+namespace
+{
+	struct thread_chunk
+	{
+		uint64_t owner = 0;
+		uint64_t epoch = 0;
+
+		uint64_t current = 0;
+		uint64_t end = 0;
+	};
+
+	// A few slots so threads working with more than one allocator don't thrash a single chunk
+	static constexpr uint32_t threadChunkSlots = 4;
+
+	thread_local thread_chunk threadChunks[threadChunkSlots];
+
+	std::atomic<uint64_t> nextAllocatorId = 1;
+}
 
-	pageSize = systemInfo.dwPageSize;
-	sizeLeftTotal = reserveSize;
+openps::eallocator::eallocator() noexcept : id(nextAllocatorId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+void openps::eallocator::initialize(uint64_t minimumBlockSize, uint64_t reserveSize, page_mode pages) noexcept
+{
+	reset(true);
+
+	// Huge page reservations have to be a multiple of the huge page size
+	if (pages != page_mode::Default)
+		reserveSize = alignTo(reserveSize, hugePageSize);
+
+	memory = reservePages(reserveSize, pages);
+	ASSERT(memory);
+
+	pageSize = pages == page_mode::ExplicitHuge ? hugePageSize : systemPageSize();
 	this->minimumBlockSize = minimumBlockSize;
 	this->reserveSize = reserveSize;
+	this->pages = pages;
+
+	frameHighWater = 0;
+	highWater = 0;
+	std::fill(windowHighWaters.begin(), windowHighWaters.end(), 0);
+	overflows.store(0, std::memory_order_relaxed);
+	trims = 0;
+	decommittedBytes = 0;
 }
 
 void openps::eallocator::ensureFreeSize(uint64_t size) noexcept
+{
+	const bool committed = commitTo(current.load(std::memory_order_relaxed) + size);
+	UNUSED(committed);
+}
+
+void openps::eallocator::setBudget(uint64_t budget, memory_budget_func_ptr func, void* userData) noexcept
 {
 	::std::unique_lock<::std::mutex> lock{ mutex };
-	ensureFreeSizeInternal(size);
+
+	this->budget = budget;
+	budgetFunc = func;
+	budgetUserData = userData;
+}
+
+void openps::eallocator::setTrimPolicy(const memory_trim_policy& policy) noexcept
+{
+	trimPolicy = policy;
+
+	windowHighWaters.assign(policy.windowFrames, 0);
+	windowIndex = 0;
+}
+
+NODISCARD openps::memory_stats openps::eallocator::getStats() const noexcept
+{
+	const uint64_t used = current.load(std::memory_order_relaxed);
+
+	memory_stats stats;
+	stats.reserved = reserveSize;
+	stats.committed = committedMemory.load(std::memory_order_relaxed);
+	stats.used = used;
+	stats.highWater = max(highWater, max(frameHighWater, used));
+	stats.windowHighWater = max(frameHighWater, used);
+	for (uint64_t peak : windowHighWaters)
+		stats.windowHighWater = max(stats.windowHighWater, peak);
+	stats.budget = budget;
+	stats.overflows = overflows.load(std::memory_order_relaxed);
+	stats.trims = trims;
+	stats.decommittedBytes = decommittedBytes;
+
+	return stats;
+}
+
+NODISCARD uint64_t openps::eallocator::claim(uint64_t size, uint64_t alignment) noexcept
+{
+	uint64_t expected = current.load(std::memory_order_relaxed);
+	uint64_t offset;
+	uint64_t end;
+
+	do
+	{
+		offset = alignTo(expected, alignment);
+		end = offset + size;
+	} while (!current.compare_exchange_weak(expected, end, std::memory_order_relaxed));
+
+	if (end > reserveSize || (end > committedMemory.load(std::memory_order_acquire) && !commitTo(end)))
+	{
+		// Give the range back unless another allocation already claimed past it
+		current.compare_exchange_strong(end, expected, std::memory_order_relaxed);
+		return invalidOffset;
+	}
+
+	return offset;
 }
 
 NODISCARD void* openps::eallocator::allocate(uint64_t size, uint64_t alignment, bool clearToZero) noexcept
@@ -26,24 +201,50 @@ NODISCARD void* openps::eallocator::allocate(uint64_t size, uint64_t alignment,
 	if (size == 0)
 		return 0;
 
-	::std::unique_lock<::std::mutex> lock{ mutex };
+	const uint64_t offset = claim(size, alignment);
+	if (offset == invalidOffset)
+		return 0;
 
-	uint64_t mask = alignment - 1;
-	uint64_t misalignment = current & mask;
-	uint64_t adjustment = (misalignment == 0) ? 0 : (alignment - misalignment);
-	current += adjustment;
+	uint8_t* result = memory + offset;
 
-	sizeLeftCurrent -= adjustment;
-	sizeLeftTotal -= adjustment;
+	if (clearToZero)
+		memset(result, 0, size);
 
-	ASSERT(sizeLeftTotal >= size);
+	return result;
+}
 
-	ensureFreeSizeInternal(size);
+NODISCARD void* openps::eallocator::allocateLocal(uint64_t size, uint64_t alignment, bool clearToZero) noexcept
+{
+	if (size == 0)
+		return 0;
+
+	if (size > threadChunkSize / 4)
+		return allocate(size, alignment, clearToZero);
 
-	uint8_t* result = memory + current;
-	current += size;
-	sizeLeftCurrent -= size;
-	sizeLeftTotal -= size;
+	const uint64_t currentEpoch = epoch.load(std::memory_order_acquire);
+
+	thread_chunk& chunk = threadChunks[id % threadChunkSlots];
+
+	uint64_t offset = alignTo(chunk.current, alignment);
+
+	if (chunk.owner != id || chunk.epoch != currentEpoch || offset + size > chunk.end)
+	{
+		// The tail of the old chunk is abandoned until the next reset
+		const uint64_t chunkOffset = claim(threadChunkSize, 64);
+		if (chunkOffset == invalidOffset)
+			return 0;
+
+		chunk.owner = id;
+		chunk.epoch = currentEpoch;
+		chunk.current = chunkOffset;
+		chunk.end = chunkOffset + threadChunkSize;
+
+		offset = alignTo(chunk.current, alignment);
+	}
+
+	chunk.current = offset + size;
+
+	uint8_t* result = memory + offset;
 
 	if (clearToZero)
 		memset(result, 0, size);
@@ -53,40 +254,126 @@ NODISCARD void* openps::eallocator::allocate(uint64_t size, uint64_t alignment,
 
 void openps::eallocator::setCurrentTo(void* ptr) noexcept
 {
-	current = (uint8_t*)ptr - memory;
-	sizeLeftCurrent = committedMemory - current;
-	sizeLeftTotal = reserveSize - current;
+	sampleHighWater();
+	current.store((uint8_t*)ptr - memory, std::memory_order_relaxed);
+	epoch.fetch_add(1, std::memory_order_release);
 }
 
 void openps::eallocator::reset(bool freeMemory) noexcept
 {
 	if (memory && freeMemory)
 	{
-		VirtualFree(memory, 0, MEM_RELEASE);
+		releasePages(memory, reserveSize);
 		memory = 0;
-		committedMemory = 0;
+		committedMemory.store(0, std::memory_order_relaxed);
 	}
 
 	resetToMarker(memory_marker{ 0 });
+
+	if (!freeMemory)
+		trim();
 }
 
 void openps::eallocator::resetToMarker(memory_marker marker) noexcept
 {
-	current = marker.before;
-	sizeLeftCurrent = committedMemory - current;
-	sizeLeftTotal = reserveSize - current;
+	sampleHighWater();
+	current.store(marker.before, std::memory_order_relaxed);
+	epoch.fetch_add(1, std::memory_order_release);
+}
+
+void openps::eallocator::decommit(uint64_t keepSize) noexcept
+{
+	::std::unique_lock<::std::mutex> lock{ mutex };
+	decommitInternal(keepSize);
+}
+
+void openps::eallocator::decommitInternal(uint64_t keepSize) noexcept
+{
+	if (!memory)
+		return;
+
+	const uint64_t committed = committedMemory.load(std::memory_order_relaxed);
+
+	const uint64_t keep = pageSize * bucketize(max(current.load(std::memory_order_relaxed), keepSize), pageSize);
+	if (keep >= committed)
+		return;
+
+	decommitPages(memory + keep, committed - keep);
+
+	decommittedBytes += committed - keep;
+	committedMemory.store(keep, std::memory_order_release);
 }
 
-void openps::eallocator::ensureFreeSizeInternal(uint64_t size) noexcept
+void openps::eallocator::trim() noexcept
 {
-	if (sizeLeftCurrent < size)
+	highWater = max(highWater, frameHighWater);
+
+	if (windowHighWaters.empty())
 	{
-		uint64_t allocationSize = max(size, minimumBlockSize);
-		allocationSize = pageSize * bucketize(allocationSize, pageSize);
-		VirtualAlloc(memory + committedMemory, allocationSize, MEM_COMMIT, PAGE_READWRITE);
+		frameHighWater = 0;
+		return;
+	}
+
+	windowHighWaters[windowIndex] = frameHighWater;
+	windowIndex = (windowIndex + 1) % (uint32_t)windowHighWaters.size();
+	frameHighWater = 0;
+
+	uint64_t windowPeak = 0;
+	for (uint64_t peak : windowHighWaters)
+		windowPeak = max(windowPeak, peak);
 
-		sizeLeftTotal += allocationSize;
-		sizeLeftCurrent += allocationSize;
-		committedMemory += allocationSize;
+	const uint64_t keep = max((uint64_t)((double)windowPeak * (1.0 + trimPolicy.slack)), trimPolicy.minimumCommit);
+
+	::std::unique_lock<::std::mutex> lock{ mutex };
+
+	// Growth commits at least minimumBlockSize, trimming less than that would just be committed again next frame
+	if (committedMemory.load(std::memory_order_relaxed) < keep + max(pageSize, minimumBlockSize))
+		return;
+
+	decommitInternal(keep);
+	++trims;
+}
+
+NODISCARD bool openps::eallocator::commitTo(uint64_t end) noexcept
+{
+	::std::unique_lock<::std::mutex> lock{ mutex };
+	return commitToInternal(end);
+}
+
+NODISCARD bool openps::eallocator::commitToInternal(uint64_t end) noexcept
+{
+	// Another thread may have committed the range while this one waited for the mutex
+	const uint64_t committed = committedMemory.load(std::memory_order_relaxed);
+	if (end <= committed)
+		return true;
+
+	if (end > reserveSize)
+		return false;
+
+	uint64_t allocationSize = max(end - committed, minimumBlockSize);
+	allocationSize = min(pageSize * bucketize(allocationSize, pageSize), reserveSize - committed);
+
+	if (budget && committed + allocationSize > budget)
+	{
+		// minimumBlockSize is only a preference, commit just what the allocation needs before calling it an overflow
+		allocationSize = pageSize * bucketize(end - committed, pageSize);
+
+		if (committed + allocationSize > budget)
+		{
+			overflows.fetch_add(1, std::memory_order_relaxed);
+
+			if (budgetFunc && !budgetFunc(*this, committed + allocationSize, budget, budgetUserData))
+				return false;
+		}
 	}
+
+	const bool success = commitPages(memory + committed, allocationSize);
+	ASSERT(success);
+
+	if (!success)
+		return false;
+
+	committedMemory.store(committed + allocationSize, std::memory_order_release);
+
+	return true;
 }
\ No newline at end of file
@@ -0,0 +1,279 @@
+#include <memory/epool.h>
+
+namespace
+{
+	// Block sizes including the header, all multiples of 16
+	static constexpr uint32_t sizeClasses[openps::epool_allocator::nbSizeClasses] =
+	{
+		32, 48, 64, 80, 96, 128, 160, 208, 272, 400, 528, 784, 1040, openps::epool_allocator::maxSmallSize + openps::epool_allocator::headerSize
+	};
+
+	static constexpr uint32_t slabSize = KB(64);
+
+	// Blocks moved between a thread cache and the shared list at once
+	static constexpr uint32_t batchSize = 32;
+
+	struct cache_slot
+	{
+		uint64_t owner = 0;
+		void* cache = nullptr;
+	};
+
+	static constexpr uint32_t cacheSlots = 4;
+
+	thread_local cache_slot threadCaches[cacheSlots];
+
+	std::atomic<uint64_t> nextPoolId = 1;
+}
+
+openps::epool_allocator::epool_allocator() noexcept : id(nextPoolId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+openps::epool_allocator::~epool_allocator()
+{
+	for (thread_cache* cache : caches)
+		delete cache;
+
+	for (void* slab : slabs)
+		alignedFree(slab);
+}
+
+NODISCARD uint32_t openps::epool_allocator::sizeClassOf(uint64_t blockSize) noexcept
+{
+	uint32_t sizeClass = 0;
+	while (sizeClasses[sizeClass] < blockSize)
+		++sizeClass;
+
+	return sizeClass;
+}
+
+NODISCARD openps::epool_allocator::thread_cache* openps::epool_allocator::getThreadCache() noexcept
+{
+	cache_slot& slot = threadCaches[id % cacheSlots];
+	if (slot.owner == id)
+		return (thread_cache*)slot.cache;
+
+	const std::thread::id self = std::this_thread::get_id();
+
+	std::lock_guard<std::mutex> lock{ cacheMutex };
+
+	// A cache left behind by a finished thread with the same id is taken over as is
+	auto iter = std::find_if(caches.begin(), caches.end(), [self](const thread_cache* cache) { return cache->owner == self; });
+
+	thread_cache* cache;
+	if (iter != caches.end())
+		cache = *iter;
+	else
+	{
+		cache = new thread_cache();
+		cache->owner = self;
+		caches.push_back(cache);
+	}
+
+	slot.owner = id;
+	slot.cache = cache;
+
+	return cache;
+}
+
+void openps::epool_allocator::refill(uint32_t sizeClass, free_list& list) noexcept
+{
+	central_list& shared = central[sizeClass];
+
+	{
+		std::lock_guard<std::mutex> lock{ shared.mutex };
+
+		while (shared.list.head && list.count < batchSize)
+		{
+			free_block* block = shared.list.head;
+			shared.list.head = block->next;
+			--shared.list.count;
+
+			block->next = list.head;
+			list.head = block;
+			++list.count;
+		}
+	}
+
+	if (list.head)
+		return;
+
+	uint8_t* slab = (uint8_t*)alignedAlloc(slabSize, 16);
+	if (!slab)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock{ slabMutex };
+		slabs.push_back(slab);
+	}
+
+	pooledBytes.fetch_add(slabSize, std::memory_order_relaxed);
+
+	const uint32_t blockSize = sizeClasses[sizeClass];
+
+	for (uint32_t offset = 0; offset + blockSize <= slabSize; offset += blockSize)
+	{
+		free_block* block = (free_block*)(slab + offset);
+		block->next = list.head;
+		list.head = block;
+		++list.count;
+	}
+}
+
+void openps::epool_allocator::spill(uint32_t sizeClass, free_list& list) noexcept
+{
+	central_list& shared = central[sizeClass];
+
+	std::lock_guard<std::mutex> lock{ shared.mutex };
+
+	for (uint32_t i = 0; i < batchSize && list.head; ++i)
+	{
+		free_block* block = list.head;
+		list.head = block->next;
+		--list.count;
+
+		block->next = shared.list.head;
+		shared.list.head = block;
+		++shared.list.count;
+	}
+}
+
+NODISCARD uint32_t openps::epool_allocator::getTypeIndex(const char* typeName) noexcept
+{
+	if (!typeName)
+		return noType;
+
+	std::lock_guard<std::mutex> lock{ typeMutex };
+
+	auto iter = typeIndices.find(typeName);
+	if (iter != typeIndices.end())
+		return iter->second;
+
+	const uint32_t index = nbTypes.load(std::memory_order_relaxed);
+	if (index == maxTypes)
+		return noType;
+
+	types[index].typeName = typeName;
+	typeIndices.emplace(typeName, index);
+	nbTypes.store(index + 1, std::memory_order_release);
+
+	return index;
+}
+
+NODISCARD void* openps::epool_allocator::allocate(size_t size, const char* typeName) noexcept
+{
+	const uint64_t blockSize = size + headerSize;
+
+	block_header* header;
+
+	if (size <= maxSmallSize)
+	{
+		const uint32_t sizeClass = sizeClassOf(blockSize);
+
+		free_list& list = getThreadCache()->lists[sizeClass];
+
+		if (!list.head)
+			refill(sizeClass, list);
+
+		if (!list.head)
+			return nullptr;
+
+		free_block* block = list.head;
+		list.head = block->next;
+		--list.count;
+
+		header = (block_header*)block;
+		header->sizeClass = sizeClass;
+	}
+	else
+	{
+		header = (block_header*)alignedAlloc(blockSize, 16);
+		if (!header)
+			return nullptr;
+
+		header->sizeClass = largeClass;
+	}
+
+	header->size = size;
+	header->typeIndex = trackTypes.load(std::memory_order_relaxed) ? getTypeIndex(typeName) : noType;
+
+	liveBytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (header->typeIndex != noType)
+	{
+		type_entry& type = types[header->typeIndex];
+
+		const uint64_t bytes = type.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		type.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+		type.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t peak = type.peakBytes.load(std::memory_order_relaxed);
+		while (peak < bytes && !type.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed));
+	}
+
+	return (uint8_t*)header + headerSize;
+}
+
+void openps::epool_allocator::deallocate(void* ptr) noexcept
+{
+	if (!ptr)
+		return;
+
+	block_header* header = (block_header*)((uint8_t*)ptr - headerSize);
+
+	liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+	if (header->typeIndex != noType)
+	{
+		type_entry& type = types[header->typeIndex];
+		type.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+		type.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	const uint32_t sizeClass = header->sizeClass;
+
+	if (sizeClass == largeClass)
+	{
+		alignedFree(header);
+		return;
+	}
+
+	// Blocks freed on another thread than they were allocated on just join this thread's list
+	free_list& list = getThreadCache()->lists[sizeClass];
+
+	free_block* block = (free_block*)header;
+	block->next = list.head;
+	list.head = block;
+	++list.count;
+
+	if (list.count > 2 * batchSize)
+		spill(sizeClass, list);
+}
+
+void openps::epool_allocator::getTypeStats(std::vector<allocation_type_stats>& result) const noexcept
+{
+	result.clear();
+
+	const uint32_t count = nbTypes.load(std::memory_order_acquire);
+
+	// The same name can come from different string literals
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const type_entry& type = types[i];
+
+		auto iter = std::find_if(result.begin(), result.end(),
+			[&type](const allocation_type_stats& stats) { return strcmp(stats.typeName, type.typeName) == 0; });
+
+		allocation_type_stats& stats = iter != result.end() ? *iter : result.emplace_back();
+
+		stats.typeName = type.typeName;
+		stats.liveBytes += type.liveBytes.load(std::memory_order_relaxed);
+		stats.peakBytes += type.peakBytes.load(std::memory_order_relaxed);
+		stats.liveAllocations += type.liveAllocations.load(std::memory_order_relaxed);
+		stats.totalAllocations += type.totalAllocations.load(std::memory_order_relaxed);
+	}
+
+	std::sort(result.begin(), result.end(),
+		[](const allocation_type_stats& a, const allocation_type_stats& b) { return a.liveBytes > b.liveBytes; });
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#include <memory/eresource.h>
+
+void* openps::eallocator_resource::do_allocate(size_t bytes, size_t alignment)
+{
+	if (void* result = arena->allocateLocal(bytes, alignment))
+		return result;
+
+	return upstream->allocate(bytes, alignment);
+}
+
+void openps::eallocator_resource::do_deallocate(void* ptr, size_t bytes, size_t alignment)
+{
+	if (!arena->owns(ptr))
+		upstream->deallocate(ptr, bytes, alignment);
+}
\ No newline at end of file